@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Run pingpong across a matrix of environment settings and merge the results.
+
+Many MPI tunables (eager limits, transport selection) can only be set in the
+environment at launch. Each combination of the given settings is launched
+once on the local machine; every run writes its own CSV, and an index maps
+run ids to their environment. merge_results.py then builds one tagged dataset
+and ranks the configurations per size band.
+
+Example:
+    python env_sweep.py --set OMPI_MCA_btl_vader_eager_limit=4096 \\
+        --set OMPI_MCA_btl_vader_eager_limit=65536 \\
+        --set OMPI_MCA_btl=self,vader --set OMPI_MCA_btl=self,tcp -- --sync=double
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import os
+import shlex
+import subprocess
+import sys
+
+import merge_results
+
+
+def parse_settings(args):
+    """Build {variable: [values]} from --matrix and --set options."""
+    matrix = {}
+    if args.matrix:
+        with open(args.matrix, "r") as f:
+            for name, values in json.load(f).items():
+                matrix[name] = [str(v) for v in values]
+    # One value per --set, so values containing commas (OMPI_MCA_btl=self,vader)
+    # need no escaping
+    for item in args.set:
+        name, _, value = item.partition("=")
+        if not name:
+            sys.exit(f"Error: --set expects VAR=value (got {item!r})")
+        matrix.setdefault(name, []).append(value)
+    return matrix
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--matrix", help="JSON file of {VAR: [values, ...]}")
+    parser.add_argument(
+        "--set",
+        action="append",
+        default=[],
+        metavar="VAR=value",
+        help="one value of one variable; repeat for more values and variables",
+    )
+    parser.add_argument("--np", type=int, default=2, help="process count (default 2)")
+    parser.add_argument("--launcher", default="mpirun", help="MPI launcher command")
+    parser.add_argument("--binary", default="./pingpong", help="pingpong binary")
+    parser.add_argument("--mode", default="sweep", help="pingpong mode (sweep or refine)")
+    parser.add_argument("--outdir", default="env_sweep", help="directory for run outputs")
+    parser.add_argument(
+        "--bands",
+        default=",".join(str(b) for b in merge_results.DEFAULT_BANDS),
+        help="upper size bounds of the bands used for ranking",
+    )
+    parser.add_argument("--dry-run", action="store_true", help="print commands only")
+    parser.add_argument("extra", nargs="*", help="arguments passed on to pingpong after --")
+    args = parser.parse_args()
+
+    matrix = parse_settings(args)
+    if not matrix:
+        sys.exit("Error: no settings given; use --set VAR=value or --matrix FILE")
+
+    os.makedirs(args.outdir, exist_ok=True)
+    names = sorted(matrix)
+    combinations = list(itertools.product(*(matrix[n] for n in names)))
+    index_path = os.path.join(args.outdir, merge_results.INDEX_FILE)
+
+    with open(index_path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["run_id", "tag", "exit_status", "output"] + names)
+        for run_id, values in enumerate(combinations):
+            env = dict(os.environ)
+            env.update(zip(names, values))
+            tag = " ".join(f"{n}={v}" for n, v in zip(names, values))
+            output = os.path.join(args.outdir, f"run_{run_id:03d}.csv")
+            command = shlex.split(args.launcher) + ["-np", str(args.np), args.binary]
+            command += [args.mode, f"--out={output}"] + args.extra
+
+            print(f"[{run_id + 1}/{len(combinations)}] {tag}")
+            if args.dry_run:
+                print("    " + " ".join(shlex.quote(c) for c in command))
+                continue
+            log_path = os.path.join(args.outdir, f"run_{run_id:03d}.log")
+            with open(log_path, "w") as log:
+                status = subprocess.call(command, env=env, stdout=log, stderr=subprocess.STDOUT)
+            if status != 0:
+                print(f"    failed with exit status {status}, see {log_path}")
+            writer.writerow([run_id, tag, status, output] + list(values))
+
+    if not args.dry_run:
+        bands = [int(b) for b in args.bands.split(",") if b]
+        merge_results.merge(args.outdir, bands)
+
+
+if __name__ == "__main__":
+    main()
@@ -7,20 +7,265 @@
  *   - Bandwidth (b): Data transfer rate
  *   - Buffer size: Point where MPI_Send becomes blocking
  *
+ * Usage: mpirun -np 2 ./pingpong [mode] [--option=value ...]
+ *
+ * Modes:
+ *   sweep   Power-of-two size sweep (default)
+ *   refine  Coarse power-of-two pass, then dense linear steps wherever the
+ *           latency or bandwidth curve shows a discontinuity
+ *   mtu     Byte-step windows around suspected packet boundaries; detects
+ *           latency steps and infers the effective payload per packet
+ *   barrier MPI_Barrier latency and exit-time skew across process counts
+ *   startup MPI_Init, communicator creation and first-message-per-peer costs
+ *   mesh    First-contact vs steady-state latency to every peer, random order
+ *   cpucost Latency vs CPU time per iteration for each receive wait strategy
+ *   match   Latency vs posted/unexpected matching-queue depth, position, wildcard
+ *   unexpected  Receiver delayed so pings land in the unexpected queue; extra
+ *           latency and bandwidth loss versus the expected path
+ *   multicomm  Concurrent ping-pong streams on duplicated communicators,
+ *           single-threaded or one thread per stream
+ *   overhead  Per-iteration cost of the timed kernels with no-op communication
+ *   batch   B round trips per timestamp, B sized to span >= 1000 timer ticks
+ *   load    Small-message latency percentiles while a background thread
+ *           streams bulk transfers on a separate communicator
+ *   openloop  Requests sent on a fixed or Poisson schedule; latency from the
+ *           intended send time across offered rates, locating the knee
+ *   rpc     Small request / large response grid with server think time and
+ *           pipelining depth
+ *   rails   1..K concurrent streaming pairs, one per rail, aggregate vs single
+ *   chunked Large messages pipelined as chunks through a window of MPI_Isend,
+ *           swept over chunk size and window, against the monolithic send
+ *   regcache Round trips from a reused buffer, a fresh mmap per iteration and
+ *           pools of W buffers, giving registration cost and the cache cliff
+ *   footprint RSS before and after first contact with 1, 2, 4, ... N peers,
+ *           K outstanding receives and a large transfer
+ *   iostall Warmup of the next size after rank 0 writes and flushes a result
+ *           row, against the same warmup with no I/O in between
+ *   cvars   Runtime-writable MPI_T eager/rendezvous/chunk control variables
+ *           swept over a set of values, rerunning the sizes for each one
+ *   exchange  Symmetric exchange via MPI_Sendrecv, MPI_Sendrecv_replace and
+ *           separate-buffer Isend/Irecv: bandwidth and peak memory per size
+ *   neighbor  MPI_Neighbor_alltoall(v) on periodic 2D/3D Cartesian and
+ *           distributed-graph communicators against a manual Isend/Irecv halo
+ *
+ * --sync=barrier|double|ping selects how ranks line up before each timed loop.
+ * --thread-level=single|funneled|serialized|multiple uses MPI_Init_thread.
+ * --timer=gtod|mono|wtime|tsc selects the clock read inside the ping-pong
+ * kernels (sweep, refine, mtu, batch, cvars, unexpected); other modes use
+ * gettimeofday.
+ * --output=buffered|live: results are held in memory and written at the end
+ * (default), or written to the console and CSV as each row is produced.
+ * --pvars=SUBSTR,...|list selects MPI_T performance variables whose names
+ * contain a substring, read around each size in sweep and refine; "list"
+ * prints every variable the library exposes. Off by default.
+ *
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <mpi.h>
 #include <assert.h>
 #include <sys/time.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #define MIN_MSG_SIZE 1            // Starting message size (1 byte)
 #define MAX_MSG_SIZE (1 << 20)    // Maximum message size (1 MB = 2^20 bytes)
 #define NUM_ITERATIONS 100        // Number of iterations for averaging
 #define WARMUP_ITERATIONS 10      // Warmup iterations (not timed)
 #define OUTPUT_FILE "results.csv" // Output file for results
+#define OUTPUT_BUFFER_SIZE (4 << 20) // In-memory buffer for stdout and the CSV
+#define MAX_PVARS 8               // MPI_T performance variables reported per size
+#define MAX_PVAR_COUNT 256        // Largest element count read from one pvar
+
+#define REFINE_STEPS 16           // Linear steps inserted into a flagged interval
+#define REFINE_THRESHOLD 0.15     // Relative deviation that marks a discontinuity
+
+#define MTU_BOUNDARIES "1024,2048,4096,8192" // Suspected packet boundaries (bytes)
+#define MTU_WINDOW 128            // Half-width of the window probed around a boundary
+#define MTU_SIGMA 5.0             // Step must exceed this many standard errors
+#define MAX_LIST 64               // Longest comma-separated list accepted as an option
+
+#define BARRIER_ITERATIONS 1000   // Barriers timed per process count
+#define OFFSET_PINGS 50           // Exchanges used to estimate each clock offset
+#define MESH_REPEATS 10           // Steady-state passes over the full mesh
+#define DEFAULT_SEED 12345        // Seed shared by all ranks for randomized schedules
+#define MATCH_MAX_DEPTH 1024      // Deepest receive/unexpected queue in match mode
+#define MATCH_TAG_BASE 100        // First tag used for queued receives and messages
+#define UNEXPECTED_DELAY_US 50.0  // Receiver delay that lets the ping arrive first
+#define STREAM_ITERATIONS 1000    // Round trips per stream in multicomm mode
+#define MAX_STREAMS 16            // Largest number of concurrent communicators
+#define OVERHEAD_ITERATIONS 1000000 // No-op iterations timed by the overhead mode
+#define OVERHEAD_TARGET_NS 20.0   // Per-iteration harness budget checked by overhead mode
+#define CALIBRATION_ITERATIONS 10000 // No-op iterations per timer in the calibration phase
+#define BATCH_SAMPLES 200         // Block samples kept per size in batch mode
+#define BATCH_MIN_TICKS 1000      // Each block must span at least this many timer ticks
+#define LOAD_LEVELS "0,25,50,75,100" // Background load levels (percent of full stream rate)
+#define LOAD_BULK_SIZE (1 << 20)  // Message size of the background stream
+#define LOAD_PROBES 2000          // Small-message round trips per load level
+#define LOAD_STOP_TAG 9           // Tells the receiving load thread to exit
+#define OPEN_RATES "10000,20000,50000,100000,200000,500000" // Offered rates (msgs/s)
+#define OPEN_REQUESTS 5000        // Requests sent per offered rate
+#define OPEN_KNEE_FACTOR 2.0      // p99 growth over the lowest rate that marks the knee
+#define RPC_REQ_SIZES "8,64,512,4096"         // Request sizes swept by rpc mode
+#define RPC_RESP_SIZES "8,1024,65536,1048576" // Response sizes swept by rpc mode
+#define RPC_DEPTHS "1,4"          // Requests kept in flight by the client
+#define RPC_REQUESTS 200          // Requests per grid cell
+#define STREAM_WINDOW 16          // Messages in flight per window in streaming tests
+#define STREAM_WINDOWS 20         // Windows timed per size in streaming tests
+#define RAIL_GAIN 1.1             // Aggregate/single ratio that counts as striping helping
+#define CHUNK_SIZES "262144,1048576,4194304"  // Message sizes for chunked transfers
+#define CHUNK_CHUNKS "8192,32768,131072,524288" // Chunk sizes swept by chunked mode
+#define CHUNK_WINDOWS "1,2,4,8"   // Chunk requests kept in flight
+#define CHUNK_ITERATIONS 20       // Round trips timed per configuration
+#define REG_SIZES "65536,1048576,4194304" // Message sizes for registration mode
+#define REG_POOLS "1,2,4,8,16,32,64" // Buffer pool sizes cycled by registration mode
+#define REG_ITERATIONS 100        // Round trips timed per configuration
+#define REG_MAX_POOL_BYTES 268435456 // Skip pools larger than this per rank
+#define FOOT_REQUESTS "16,256,4096" // Outstanding receive counts in footprint mode
+#define FOOT_LARGE_SIZE 16777216  // Message size for the large-transfer footprint
+#define IOSTALL_SIZES "8,1024,65536" // Message sizes for iostall mode
+#define IOSTALL_REPEATS 10        // Quiet/stdio pairs per size
+#define EXCHANGE_ITERATIONS 100   // Exchanges timed per size and method
+#define NEIGHBOR_SIZES "8,1024,16384,262144" // Bytes per neighbor in neighbor mode
+#define NEIGHBOR_ITERATIONS 100   // Exchanges timed per topology, size and method
+#define MAX_CVARS 4               // Control variables swept by cvars mode
+#define CVAR_DEFAULT "eager,rndv,pipeline,chunk" // Name substrings swept by default
+#define CVAR_SIZES "256,1024,4096,16384,65536,262144,1048576" // Sizes rerun per setting
+#define CVAR_TUNING_FILE "tuning.conf" // Best setting per size band
+
+// How ranks line up before a timed loop (--sync=barrier|double|ping)
+enum
+{
+    SYNC_BARRIER, // One MPI_Barrier
+    SYNC_DOUBLE,  // Two back-to-back barriers: the second starts from a tight entry
+    SYNC_PING     // Zero-byte ping: rank 1 is posted when rank 0 starts the clock
+};
+
+static int sync_mode = SYNC_BARRIER;
+
+// Result output (--output=buffered|live). Buffered mode keeps stdout and the
+// CSV in memory so no write() lands between measurement phases; everything
+// is written at fclose() or exit.
+static int output_live = 0;
+static char stdout_buffer[OUTPUT_BUFFER_SIZE];
+static char csv_buffer[OUTPUT_BUFFER_SIZE]; // Modes keep one CSV open at a time
+
+// How a receive waits for its message
+enum
+{
+    WAIT_RECV,  // Blocking MPI_Recv, library decides whether to spin or sleep
+    WAIT_SPIN,  // MPI_Irecv then MPI_Test in a tight loop
+    WAIT_YIELD, // MPI_Irecv then MPI_Test plus sched_yield between polls
+    WAIT_WAIT,  // MPI_Irecv then MPI_Wait
+    NUM_WAITS
+};
+
+static const char *wait_names[NUM_WAITS] = {"recv", "spin", "yield", "wait"};
+
+// Clock read inside the timed kernels (--timer=gtod|mono|wtime|tsc)
+enum
+{
+    TIMER_GTOD,  // gettimeofday, microsecond ticks (the original timer)
+    TIMER_MONO,  // clock_gettime(CLOCK_MONOTONIC), nanosecond ticks
+    TIMER_WTIME, // MPI_Wtime, nanosecond ticks
+    TIMER_TSC,   // CPU cycle counter, calibrated against CLOCK_MONOTONIC
+    NUM_TIMERS
+};
+
+static const char *timer_names[NUM_TIMERS] = {"gtod", "mono", "wtime", "tsc"};
+static double timer_us_per_tick[NUM_TIMERS] = {1.0, 1e-3, 1e-3, 0.0};
+static int timer_backend = TIMER_GTOD;
+
+// Harness overhead of one timer, measured with no-op communication
+typedef struct
+{
+    double first_us;  // Mean interval around the first op of an iteration
+    double second_us; // Mean interval around the second op
+    double median_us; // Whole-iteration distribution
+    double p99_us;
+    double mean_us;
+} Calibration;
+
+static Calibration calibration[NUM_TIMERS];
+
+// Communication performed by the timed kernels
+enum
+{
+    COMM_MPI,  // MPI_Send / MPI_Recv
+    COMM_NOOP, // Nothing: measures the harness itself
+    NUM_COMMS
+};
+
+// Startup costs captured in main() before the mode runs
+static double startup_exec_us = -1.0; // exec() to main() entry, -1 if unknown
+static double startup_init_us = 0.0;  // MPI_Init or MPI_Init_thread duration
+static int thread_provided = MPI_THREAD_SINGLE;
+
+// Averaged timings for one message size
+typedef struct
+{
+    int msg_size;
+    double avg_send;
+    double avg_recv;
+    double avg_rtt;
+    double bandwidth_mbps;
+    double corr_send; // Same timings with the harness overhead subtracted
+    double corr_recv;
+    double corr_rtt;
+    double corr_bandwidth_mbps;
+    double pvar[MAX_PVARS]; // MPI_T values, summed over both ranks
+} SizeResult;
+
+// One selected MPI_T performance variable
+typedef struct
+{
+    char name[64];
+    int var_class;
+    MPI_Datatype datatype;
+    int count;      // Elements per read, summed into one value
+    int is_delta;   // Counters and timers: change per round trip; others: value after
+    MPI_T_pvar_handle handle;
+} Pvar;
+
+static MPI_T_pvar_session pvar_session;
+static Pvar pvars[MAX_PVARS];
+static int num_pvars = 0;
+static int pvars_available = 0; // Total pvars the library exposes
+static int pvar_initialized = 0; // MPI_T_init_thread succeeded in pvar_setup
+
+// Order statistics over a set of per-iteration samples
+typedef struct
+{
+    double min;
+    double median;
+    double p99;
+    double max;
+    double mean;
+} Stats;
+
+// A benchmark mode selectable from the command line
+typedef struct
+{
+    const char *name;
+    int (*run)(int argc, char *argv[], int rank, int num_procs);
+    int needs_pair;          // Requires exactly 2 processes
+    const char *description;
+} Mode;
 
 // Get time in microseconds
 double get_time_us()
@@ -30,228 +275,5434 @@ double get_time_us()
     return (double)tv.tv_sec * 1000000.0 + (double)tv.tv_usec;
 }
 
-int main(int argc, char *argv[])
+// Time since this process was exec'd, from /proc (clock-tick resolution)
+static double exec_elapsed_us(void)
 {
-    int rank, num_procs;
+#if defined(__linux__) && defined(CLOCK_BOOTTIME)
+    FILE *stat_file = fopen("/proc/self/stat", "r");
+    if (!stat_file)
+    {
+        return -1.0;
+    }
 
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    char line[1024];
+    char *fields = fgets(line, sizeof(line), stat_file) ? strrchr(line, ')') : NULL;
+    fclose(stat_file);
+    if (!fields)
+    {
+        return -1.0;
+    }
 
-    // Ensure exactly 2 processes
-    if (num_procs != 2)
+    // Field 22 (starttime) is the 20th field after the command name
+    unsigned long long start_ticks = 0;
+    char *token = strtok(fields + 1, " ");
+    for (int i = 0; token && i < 19; i++)
+    {
+        token = strtok(NULL, " ");
+    }
+    if (!token)
+    {
+        return -1.0;
+    }
+    start_ticks = strtoull(token, NULL, 10);
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    double now_us = (double)now.tv_sec * 1000000.0 + (double)now.tv_nsec / 1000.0;
+    return now_us - (double)start_ticks * 1000000.0 / (double)sysconf(_SC_CLK_TCK);
+#else
+    return -1.0;
+#endif
+}
+
+// Busy-wait for the given number of microseconds without entering MPI
+static void spin_us(double us)
+{
+    double t_end = get_time_us() + us;
+    while (get_time_us() < t_end)
+    {
+    }
+}
+
+// Wait without burning the CPU for long gaps; spin for short ones
+static void pause_us(double us)
+{
+    if (us > 100.0)
+    {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(us / 1000000.0);
+        ts.tv_nsec = (long)((us - ts.tv_sec * 1000000.0) * 1000.0);
+        nanosleep(&ts, NULL);
+    }
+    else if (us > 0.0)
+    {
+        spin_us(us);
+    }
+}
+
+// CPU time consumed by the calling thread, in microseconds
+static double thread_cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+// User plus system CPU time of the whole process (includes progress threads)
+static double process_cpu_us(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000.0 +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+// Resident set size in bytes from /proc/self/statm, or -1 where unavailable
+static double rss_bytes(void)
+{
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+    {
+        return -1.0;
+    }
+
+    unsigned long pages_total = 0, pages_resident = 0;
+    int fields = fscanf(statm, "%lu %lu", &pages_total, &pages_resident);
+    fclose(statm);
+    if (fields != 2)
+    {
+        return -1.0;
+    }
+    return (double)pages_resident * (double)sysconf(_SC_PAGESIZE);
+}
+
+// Peak resident set size (VmHWM) in bytes from /proc/self/status, or -1
+static double peak_rss_bytes(void)
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    if (!status)
+    {
+        return -1.0;
+    }
+
+    char line[256];
+    double peak = -1.0;
+    while (fgets(line, sizeof(line), status))
+    {
+        unsigned long kb;
+        if (sscanf(line, "VmHWM: %lu kB", &kb) == 1)
+        {
+            peak = (double)kb * 1024.0;
+            break;
+        }
+    }
+    fclose(status);
+    return peak;
+}
+
+// Reset VmHWM to the current RSS (Linux 4.0+); returns 0 where unsupported
+static int reset_peak_rss(void)
+{
+    FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+    if (!clear_refs)
+    {
+        return 0;
+    }
+    int ok = fputs("5", clear_refs) >= 0;
+    return (fclose(clear_refs) == 0) && ok;
+}
+
+// Receive using one of the wait strategies
+static void recv_with(int strategy, void *buffer, int count, int source, int tag, MPI_Comm comm)
+{
+    MPI_Request request;
+    int done = 0;
+
+    switch (strategy)
+    {
+    case WAIT_SPIN:
+        MPI_Irecv(buffer, count, MPI_BYTE, source, tag, comm, &request);
+        while (!done)
+        {
+            MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+        }
+        break;
+    case WAIT_YIELD:
+        MPI_Irecv(buffer, count, MPI_BYTE, source, tag, comm, &request);
+        MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+        while (!done)
+        {
+            sched_yield();
+            MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+        }
+        break;
+    case WAIT_WAIT:
+        MPI_Irecv(buffer, count, MPI_BYTE, source, tag, comm, &request);
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        break;
+    default:
+        MPI_Recv(buffer, count, MPI_BYTE, source, tag, comm, MPI_STATUS_IGNORE);
+        break;
+    }
+}
+
+// Line up rank 0 and rank 1 before a timed loop
+static void sync_start(int rank)
+{
+    char token = 0;
+
+    switch (sync_mode)
     {
+    case SYNC_DOUBLE:
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM_WORLD);
+        break;
+    case SYNC_PING:
         if (rank == 0)
         {
-            fprintf(stderr, "Error: This program requires exactly 2 processes.\n");
-            fprintf(stderr, "Usage: mpirun -np 2 -N 2 ./pingpong\n");
+            MPI_Send(&token, 0, MPI_BYTE, 1, 1, MPI_COMM_WORLD);
+            MPI_Recv(&token, 0, MPI_BYTE, 1, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
         }
-        MPI_Finalize();
-        return 1;
+        else
+        {
+            MPI_Recv(&token, 0, MPI_BYTE, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Send(&token, 0, MPI_BYTE, 0, 1, MPI_COMM_WORLD);
+        }
+        break;
+    default:
+        MPI_Barrier(MPI_COMM_WORLD);
+        break;
     }
+}
 
-    // Open output file and print headers (rank 0 only)
-    FILE *outfile = NULL;
-    if (rank == 0)
+// xorshift64* generator; every rank seeded alike draws the same sequence
+static unsigned long long next_random(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+// Look up "--name=value" in argv, returning def if the option is absent
+static const char *opt_str(int argc, char *argv[], const char *name, const char *def)
+{
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++)
     {
-        outfile = fopen(OUTPUT_FILE, "w");
-        if (!outfile)
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, len) == 0 &&
+            argv[i][2 + len] == '=')
         {
-            fprintf(stderr, "Error: Could not open output file %s\n", OUTPUT_FILE);
-            MPI_Finalize();
-            return 1;
+            return argv[i] + 3 + len;
         }
+    }
+    return def;
+}
+
+static long opt_long(int argc, char *argv[], const char *name, long def)
+{
+    const char *value = opt_str(argc, argv, name, NULL);
+    return value ? strtol(value, NULL, 0) : def;
+}
+
+static double opt_double(int argc, char *argv[], const char *name, double def)
+{
+    const char *value = opt_str(argc, argv, name, NULL);
+    return value ? strtod(value, NULL) : def;
+}
 
-        // Write CSV header
-        fprintf(outfile, "msg_size_bytes,avg_send_us,avg_recv_us,rtt_us,bandwidth_mbps\n");
+// Parse a comma-separated list of integers, returning how many were read
+static int parse_int_list(const char *text, int *values, int max_values)
+{
+    int count = 0;
+    while (text && *text && count < max_values)
+    {
+        char *end;
+        values[count++] = (int)strtol(text, &end, 0);
+        text = (*end == ',') ? end + 1 : NULL;
+    }
+    return count;
+}
 
-        // Print to console
-        printf("Ping-Pong Test (%d iterations, %d warmup)\n\n", NUM_ITERATIONS, WARMUP_ITERATIONS);
-        printf("%10s %12s %12s %12s %12s\n",
-               "Size (B)", "Send (us)", "Recv (us)", "RTT (us)", "BW (MB/s)");
-        printf("---------- ------------ ------------ ------------ ------------\n");
+// Open the CSV output file (rank 0 only)
+static FILE *open_output(const char *path)
+{
+    FILE *outfile = fopen(path, "w");
+    if (!outfile)
+    {
+        fprintf(stderr, "Error: Could not open output file %s\n", path);
+    }
+    else if (!output_live)
+    {
+        setvbuf(outfile, csv_buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
     }
+    return outfile;
+}
 
-    // Allocate buffers for the largest message size
-    char *send_buffer = (char *)malloc(MAX_MSG_SIZE);
-    char *recv_buffer = (char *)malloc(MAX_MSG_SIZE);
+// Allocate and initialize send/receive buffers for the largest message size
+static int alloc_buffers(int rank, size_t size, char **send_buffer, char **recv_buffer)
+{
+    *send_buffer = (char *)malloc(size);
+    *recv_buffer = (char *)malloc(size);
 
-    if (!send_buffer || !recv_buffer)
+    if (!*send_buffer || !*recv_buffer)
     {
         fprintf(stderr, "Rank %d: Failed to allocate memory\n", rank);
-        MPI_Finalize();
-        return 1;
+        free(*send_buffer);
+        free(*recv_buffer);
+        return 0;
     }
 
     // Initialize send buffer with some data
-    memset(send_buffer, 'A', MAX_MSG_SIZE);
-    memset(recv_buffer, 0, MAX_MSG_SIZE);
+    memset(*send_buffer, 'A', size);
+    memset(*recv_buffer, 0, size);
+    return 1;
+}
 
-    MPI_Status status;
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
 
-    // Variables to track estimates
-    double min_rtt = 1e9;         // For latency estimation (smallest RTT)
-    double max_bandwidth = 0.0;   // For bandwidth estimation (largest bandwidth)
-    int buffer_size_estimate = 0; // For buffer size detection
-    double prev_send_time = 0.0;  // To detect buffer size threshold
-    int buffer_detected = 0;      // Flag for buffer detection
+// Quantile q of an already sorted array
+static double percentile(const double *sorted, int n, double q)
+{
+    return n > 0 ? sorted[(int)(q * (n - 1))] : 0.0;
+}
 
-    // Iterate over message sizes (1, 2, 4, 8, ..., 1MB)
-    for (int msg_size = MIN_MSG_SIZE; msg_size <= MAX_MSG_SIZE; msg_size *= 2)
+// Sort samples in place and summarize them
+static void compute_stats(double *samples, int n, Stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (n <= 0)
     {
+        return;
+    }
 
-        double total_send_time = 0.0;
-        double total_recv_time = 0.0;
-        double total_rtt = 0.0;
+    qsort(samples, n, sizeof(double), compare_double);
 
-        // Warmup rounds (not timed) - helps stabilize measurements
-        for (int i = 0; i < WARMUP_ITERATIONS; i++)
-        {
-            if (rank == 0)
-            {
-                // Rank 0: Send then Receive (ping)
-                MPI_Send(send_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD);
-                MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &status);
-            }
-            else
-            {
-                // Rank 1: Receive then Send (pong)
-                MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD, &status);
-                MPI_Send(send_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
-            }
-        }
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += samples[i];
+    }
+    stats->min = samples[0];
+    stats->median = samples[n / 2];
+    stats->p99 = percentile(samples, n, 0.99);
+    stats->max = samples[n - 1];
+    stats->mean = sum / n;
+}
 
-        // Synchronize before timing
-        MPI_Barrier(MPI_COMM_WORLD);
+// Timer backends. Each returns raw ticks; timer_us_per_tick converts them
+// after the timed region so the kernels never do floating-point work.
+static inline uint64_t timer_read_gtod(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
 
-        // Timed iterations
-        for (int i = 0; i < NUM_ITERATIONS; i++)
-        {
-            double t_start, t_after_send, t_after_recv;
+static inline uint64_t timer_read_mono(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
 
-            if (rank == 0)
-            {
-                // Rank 0: PING (send) then receive PONG
-                t_start = get_time_us();
-                MPI_Send(send_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD);
-                t_after_send = get_time_us();
-                MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &status);
-                t_after_recv = get_time_us();
+static inline uint64_t timer_read_wtime(void)
+{
+    return (uint64_t)(MPI_Wtime() * 1e9);
+}
 
-                total_send_time += (t_after_send - t_start);
-                total_recv_time += (t_after_recv - t_after_send);
-                total_rtt += (t_after_recv - t_start);
-            }
-            else
-            {
-                // Rank 1: Receive PING then send PONG
-                t_start = get_time_us();
-                MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD, &status);
-                t_after_recv = get_time_us();
-                MPI_Send(send_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
-                t_after_send = get_time_us();
+static inline uint64_t timer_read_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return timer_read_mono();
+#endif
+}
 
-                total_recv_time += (t_after_recv - t_start);
-                total_send_time += (t_after_send - t_after_recv);
-            }
-        }
+// Cycle-counter period, measured against CLOCK_MONOTONIC over ~20 ms
+static void calibrate_tsc(void)
+{
+    uint64_t mono_start = timer_read_mono();
+    uint64_t tsc_start = timer_read_tsc();
+    while (timer_read_mono() - mono_start < 20000000u)
+    {
+    }
+    uint64_t mono_end = timer_read_mono();
+    uint64_t tsc_end = timer_read_tsc();
 
-        // Calculate averages
-        double avg_send = total_send_time / NUM_ITERATIONS;
-        double avg_recv = total_recv_time / NUM_ITERATIONS;
-        double avg_rtt = total_rtt / NUM_ITERATIONS;
+    timer_us_per_tick[TIMER_TSC] = (double)(mono_end - mono_start) / 1000.0 /
+                                   (double)(tsc_end - tsc_start);
+}
 
-        // Calculate bandwidth (MB/s) using RTT (round-trip sends 2x the data)
-        // Bandwidth = (2 * msg_size) / RTT
-        double bandwidth_mbps = 0.0;
-        if (avg_rtt > 0)
-        {
-            bandwidth_mbps = (2.0 * msg_size) / avg_rtt; // bytes/microsecond = MB/s
-        }
+// Arguments shared by every timed kernel
+typedef struct
+{
+    char *send_buffer;
+    char *recv_buffer;
+    int msg_size;
+    int peer;
+    MPI_Comm comm;
+    int iterations;
+    int batch; // Round trips per timestamp (batched kernels only)
+} KernelArgs;
 
-        // Only rank 0 prints and saves results
-        if (rank == 0)
-        {
-            // Print to console
-            printf("%10d %12.2f %12.2f %12.2f %12.2f\n",
-                   msg_size, avg_send, avg_recv, avg_rtt, bandwidth_mbps);
+// Records 2 * iterations + 1 timestamps: t[0] at start, then one after the
+// first and one after the second operation of every iteration
+typedef void (*Kernel)(const KernelArgs *args, uint64_t *t);
 
-            // Write to CSV file
-            fprintf(outfile, "%d,%.2f,%.2f,%.2f,%.2f\n",
-                    msg_size, avg_send, avg_recv, avg_rtt, bandwidth_mbps);
+// Communication operations plugged into the kernels. The no-op variants only
+// stop the compiler from merging the timer reads.
+#define MPI_SEND_OP() MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, comm)
+#define MPI_RECV_OP() MPI_Recv(recv_buffer, msg_size, MPI_BYTE, peer, 0, comm, MPI_STATUS_IGNORE)
+#define NOOP_SEND_OP() __asm__ volatile("" ::: "memory")
+#define NOOP_RECV_OP() __asm__ volatile("" ::: "memory")
 
-            // Track minimum RTT (for latency - use small message sizes)
-            if (msg_size <= 64 && avg_rtt < min_rtt)
-            {
-                min_rtt = avg_rtt;
-            }
+// Rank 0 (ping: send then receive) and rank 1 (pong: receive then send)
+// kernels for one communication op and timer. Everything is resolved at
+// compile time; the timed loop has no rank test and no indirect call.
+#define DEFINE_KERNELS(comm_name, COMM, timer)                                \
+    static void ping_##comm_name##_##timer(const KernelArgs *args, uint64_t *t) \
+    {                                                                         \
+        char *send_buffer = args->send_buffer;                                \
+        char *recv_buffer = args->recv_buffer;                                \
+        const int msg_size = args->msg_size;                                  \
+        const int peer = args->peer;                                          \
+        MPI_Comm comm = args->comm;                                           \
+        const int n = args->iterations;                                       \
+        (void)send_buffer, (void)recv_buffer, (void)msg_size, (void)peer, (void)comm; \
+        t[0] = timer_read_##timer();                                          \
+        for (int i = 0; i < n; i++)                                           \
+        {                                                                     \
+            COMM##_SEND_OP();                                                 \
+            t[2 * i + 1] = timer_read_##timer();                              \
+            COMM##_RECV_OP();                                                 \
+            t[2 * i + 2] = timer_read_##timer();                              \
+        }                                                                     \
+    }                                                                         \
+    static void pong_##comm_name##_##timer(const KernelArgs *args, uint64_t *t) \
+    {                                                                         \
+        char *send_buffer = args->send_buffer;                                \
+        char *recv_buffer = args->recv_buffer;                                \
+        const int msg_size = args->msg_size;                                  \
+        const int peer = args->peer;                                          \
+        MPI_Comm comm = args->comm;                                           \
+        const int n = args->iterations;                                       \
+        (void)send_buffer, (void)recv_buffer, (void)msg_size, (void)peer, (void)comm; \
+        t[0] = timer_read_##timer();                                          \
+        for (int i = 0; i < n; i++)                                           \
+        {                                                                     \
+            COMM##_RECV_OP();                                                 \
+            t[2 * i + 1] = timer_read_##timer();                              \
+            COMM##_SEND_OP();                                                 \
+            t[2 * i + 2] = timer_read_##timer();                              \
+        }                                                                     \
+    }
 
-            // Track maximum bandwidth (for bandwidth estimation)
-            if (bandwidth_mbps > max_bandwidth)
-            {
-                max_bandwidth = bandwidth_mbps;
-            }
+// Ticks per back-to-back timer read, eight reads per loop trip so loop
+// control is amortized away
+#define DEFINE_READ_COST(timer)                                               \
+    static double read_cost_##timer(int reps)                                 \
+    {                                                                         \
+        volatile uint64_t sink;                                               \
+        uint64_t start = timer_read_##timer();                                \
+        for (int i = 0; i < reps; i++)                                        \
+        {                                                                     \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+            sink = timer_read_##timer();                                      \
+        }                                                                     \
+        (void)sink;                                                           \
+        return (double)(timer_read_##timer() - start) / (8.0 * reps + 1.0);   \
+    }
 
-            // Detect buffer size: look for significant jump in send time
-            // When message exceeds buffer, MPI_Send blocks, causing longer send times
-            if (!buffer_detected && prev_send_time > 0)
-            {
-                // If send time increases by more than 50%, buffer threshold likely exceeded
-                if (avg_send > prev_send_time * 1.5 && msg_size >= 1024)
-                {
-                    buffer_size_estimate = msg_size / 2; // Previous size was within buffer
-                    buffer_detected = 1;
-                }
-            }
-            prev_send_time = avg_send;
-        }
+// Batched kernels: one timestamp per block of args->batch round trips, so
+// t holds iterations + 1 block boundaries
+#define DEFINE_BATCH_KERNELS(timer)                                           \
+    static void ping_batch_##timer(const KernelArgs *args, uint64_t *t)      \
+    {                                                                         \
+        char *send_buffer = args->send_buffer;                                \
+        char *recv_buffer = args->recv_buffer;                                \
+        const int msg_size = args->msg_size;                                  \
+        const int peer = args->peer;                                          \
+        MPI_Comm comm = args->comm;                                           \
+        const int n = args->iterations;                                       \
+        const int batch = args->batch;                                        \
+        t[0] = timer_read_##timer();                                          \
+        for (int i = 0; i < n; i++)                                           \
+        {                                                                     \
+            for (int j = 0; j < batch; j++)                                   \
+            {                                                                 \
+                MPI_SEND_OP();                                                \
+                MPI_RECV_OP();                                                \
+            }                                                                 \
+            t[i + 1] = timer_read_##timer();                                  \
+        }                                                                     \
+    }                                                                         \
+    static void pong_batch_##timer(const KernelArgs *args, uint64_t *t)      \
+    {                                                                         \
+        char *send_buffer = args->send_buffer;                                \
+        char *recv_buffer = args->recv_buffer;                                \
+        const int msg_size = args->msg_size;                                  \
+        const int peer = args->peer;                                          \
+        MPI_Comm comm = args->comm;                                           \
+        const int n = args->iterations;                                       \
+        const int batch = args->batch;                                        \
+        t[0] = timer_read_##timer();                                          \
+        for (int i = 0; i < n; i++)                                           \
+        {                                                                     \
+            for (int j = 0; j < batch; j++)                                   \
+            {                                                                 \
+                MPI_RECV_OP();                                                \
+                MPI_SEND_OP();                                                \
+            }                                                                 \
+            t[i + 1] = timer_read_##timer();                                  \
+        }                                                                     \
+    }
 
-        // Synchronize before next message size
-        MPI_Barrier(MPI_COMM_WORLD);
+#define DEFINE_TIMER_KERNELS(timer)      \
+    DEFINE_KERNELS(mpi, MPI, timer)      \
+    DEFINE_KERNELS(noop, NOOP, timer)    \
+    DEFINE_BATCH_KERNELS(timer)          \
+    DEFINE_READ_COST(timer)
+
+DEFINE_TIMER_KERNELS(gtod)
+DEFINE_TIMER_KERNELS(mono)
+DEFINE_TIMER_KERNELS(wtime)
+DEFINE_TIMER_KERNELS(tsc)
+
+static const Kernel ping_kernels[NUM_COMMS][NUM_TIMERS] = {
+    {ping_mpi_gtod, ping_mpi_mono, ping_mpi_wtime, ping_mpi_tsc},
+    {ping_noop_gtod, ping_noop_mono, ping_noop_wtime, ping_noop_tsc},
+};
+
+static const Kernel pong_kernels[NUM_COMMS][NUM_TIMERS] = {
+    {pong_mpi_gtod, pong_mpi_mono, pong_mpi_wtime, pong_mpi_tsc},
+    {pong_noop_gtod, pong_noop_mono, pong_noop_wtime, pong_noop_tsc},
+};
+
+static const Kernel ping_batch_kernels[NUM_TIMERS] = {
+    ping_batch_gtod, ping_batch_mono, ping_batch_wtime, ping_batch_tsc,
+};
+
+static const Kernel pong_batch_kernels[NUM_TIMERS] = {
+    pong_batch_gtod, pong_batch_mono, pong_batch_wtime, pong_batch_tsc,
+};
+
+static double (*const read_costs[NUM_TIMERS])(int) = {
+    read_cost_gtod, read_cost_mono, read_cost_wtime, read_cost_tsc,
+};
+
+// Run the kernel for this rank's side of the ping-pong (selected before the
+// timed region) and leave the timestamps in t
+static void run_kernel(int rank, int comm_op, int msg_size, char *send_buffer,
+                       char *recv_buffer, int iterations, uint64_t *t)
+{
+    KernelArgs args = {send_buffer, recv_buffer, msg_size, 1 - rank, MPI_COMM_WORLD, iterations, 1};
+    Kernel kernel = (rank == 0) ? ping_kernels[comm_op][timer_backend]
+                                : pong_kernels[comm_op][timer_backend];
+    kernel(&args, t);
+}
+
+// One read of the active backend, for timed loops outside the kernels
+static uint64_t timer_read(void)
+{
+    switch (timer_backend)
+    {
+    case TIMER_MONO:
+        return timer_read_mono();
+    case TIMER_WTIME:
+        return timer_read_wtime();
+    case TIMER_TSC:
+        return timer_read_tsc();
+    default:
+        return timer_read_gtod();
     }
+}
 
-    // Print footer with analysis hints and close file
-    if (rank == 0)
+// Convert a kernel timestamp difference to microseconds
+static double ticks_to_us(uint64_t ticks)
+{
+    return (double)ticks * timer_us_per_tick[timer_backend];
+}
+
+// Tick of a timer backend in microseconds: the smallest difference it can
+// report, as opposed to how long one read takes
+static double timer_tick_us(int timer)
+{
+    struct timespec res;
+    switch (timer)
     {
-        // Calculate derived estimates
-        double latency_estimate = min_rtt / 2.0;   // One-way latency from RTT
-        double bandwidth_estimate = max_bandwidth; // MB/s
+    case TIMER_MONO:
+        clock_getres(CLOCK_MONOTONIC, &res);
+        return res.tv_sec * 1e6 + res.tv_nsec * 1e-3;
+    case TIMER_WTIME:
+        return MPI_Wtick() * 1e6;
+    case TIMER_TSC:
+        return timer_us_per_tick[TIMER_TSC];
+    default:
+        return 1.0; // gettimeofday reports whole microseconds
+    }
+}
 
-        // Print summary
-        printf("\n--- Results ---\n");
-        printf("Latency: %.2f us (RTT/2 for small msgs)\n", latency_estimate);
-        printf("Bandwidth: %.2f MB/s (max observed)\n", bandwidth_estimate);
-        if (buffer_detected)
-        {
-            printf("Buffer size: ~%d bytes\n", buffer_size_estimate);
-        }
-        else
+// Calibration phase: run this rank's kernel with no-op communication for every
+// timer and keep the overhead distribution. Means are what gets subtracted
+// from averaged timings; they stay meaningful below a coarse timer's tick.
+static void calibrate_harness(int rank)
+{
+    uint64_t *t = (uint64_t *)malloc((2 * (size_t)CALIBRATION_ITERATIONS + 1) * sizeof(uint64_t));
+    double *iter = (double *)malloc(CALIBRATION_ITERATIONS * sizeof(double));
+    int saved_backend = timer_backend;
+
+    for (int timer = 0; timer < NUM_TIMERS; timer++)
+    {
+        Calibration *cal = &calibration[timer];
+        double first = 0.0, second = 0.0;
+
+        timer_backend = timer;
+        run_kernel(rank, COMM_NOOP, 0, NULL, NULL, CALIBRATION_ITERATIONS, t);
+        for (int i = 0; i < CALIBRATION_ITERATIONS; i++)
         {
-            printf("Buffer size: >1MB (no blocking seen)\n");
+            first += ticks_to_us(t[2 * i + 1] - t[2 * i]);
+            second += ticks_to_us(t[2 * i + 2] - t[2 * i + 1]);
+            iter[i] = ticks_to_us(t[2 * i + 2] - t[2 * i]);
         }
-        printf("\n");
 
-        // Write summary to CSV file
-        fprintf(outfile, "\n");
-        fprintf(outfile, "# Latency: %.2f us\n", latency_estimate);
-        fprintf(outfile, "# Bandwidth: %.2f MB/s\n", bandwidth_estimate);
-        if (buffer_detected)
+        Stats stats;
+        compute_stats(iter, CALIBRATION_ITERATIONS, &stats);
+        cal->first_us = first / CALIBRATION_ITERATIONS;
+        cal->second_us = second / CALIBRATION_ITERATIONS;
+        cal->median_us = stats.median;
+        cal->p99_us = stats.p99;
+        cal->mean_us = stats.mean;
+    }
+    timer_backend = saved_backend;
+
+    free(t);
+    free(iter);
+}
+
+// Ping-pong between rank 0 and rank 1, recording every round trip on rank 0.
+// Rank 1 only echoes; rtt may be NULL there.
+static void pingpong_samples(int rank, int msg_size, char *send_buffer, char *recv_buffer,
+                             int iterations, double *rtt)
+{
+    MPI_Status status;
+    int peer = 1 - rank;
+
+    // Warmup rounds (not timed)
+    for (int i = 0; i < WARMUP_ITERATIONS; i++)
+    {
+        if (rank == 0)
         {
-            fprintf(outfile, "# Buffer size: %d bytes\n", buffer_size_estimate);
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &status);
         }
         else
         {
-            fprintf(outfile, "# Buffer size: >1MB\n");
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &status);
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
         }
-
-        fclose(outfile);
-        printf("Saved to %s\n", OUTPUT_FILE);
     }
 
-    // Cleanup
-    free(send_buffer);
-    free(recv_buffer);
+    uint64_t *t = (uint64_t *)malloc((2 * (size_t)iterations + 1) * sizeof(uint64_t));
 
-    MPI_Finalize();
+    sync_start(rank);
+    run_kernel(rank, COMM_MPI, msg_size, send_buffer, recv_buffer, iterations, t);
+
+    if (rank == 0)
+    {
+        for (int i = 0; i < iterations; i++)
+        {
+            rtt[i] = ticks_to_us(t[2 * i + 2] - t[2 * i]);
+        }
+    }
+    free(t);
+}
+
+// Enumerate the library's performance variables and open a handle on each
+// whose name contains one of the comma-separated substrings. Variables bound
+// to anything but no object or a communicator are skipped, as are repeated
+// names and any the library refuses to open. Selection is opt-in: some
+// libraries crash allocating handles for components that were never opened
+// (Open MPI 4.1 with the psm2 counters), so choose names for the transport
+// actually in use.
+static void pvar_setup(int rank, const char *selection)
+{
+    int provided;
+    if (!selection || MPI_T_init_thread(MPI_THREAD_SINGLE, &provided) != MPI_SUCCESS)
+    {
+        return;
+    }
+    pvar_initialized = 1;
+    MPI_T_pvar_session_create(&pvar_session);
+    MPI_T_pvar_get_num(&pvars_available);
+
+    static MPI_Comm world = MPI_COMM_WORLD; // Object handle for communicator-bound pvars
+    for (int i = 0; i < pvars_available && num_pvars < MAX_PVARS; i++)
+    {
+        Pvar *pv = &pvars[num_pvars];
+        int name_len = sizeof(pv->name), desc_len = 0;
+        int verbosity, bind, readonly, continuous, atomic;
+        MPI_T_enum enumtype;
+        if (MPI_T_pvar_get_info(i, pv->name, &name_len, &verbosity, &pv->var_class,
+                                &pv->datatype, &enumtype, NULL, &desc_len, &bind, &readonly,
+                                &continuous, &atomic) != MPI_SUCCESS)
+        {
+            continue;
+        }
+        if (strcmp(selection, "list") == 0)
+        {
+            if (rank == 0)
+            {
+                printf("pvar %4d  %s\n", i, pv->name);
+            }
+            continue;
+        }
+        if (bind != MPI_T_BIND_NO_OBJECT && bind != MPI_T_BIND_MPI_COMM)
+        {
+            continue;
+        }
+        if (pv->datatype != MPI_UNSIGNED && pv->datatype != MPI_UNSIGNED_LONG &&
+            pv->datatype != MPI_UNSIGNED_LONG_LONG && pv->datatype != MPI_INT &&
+            pv->datatype != MPI_COUNT && pv->datatype != MPI_DOUBLE)
+        {
+            continue;
+        }
+
+        int selected = 0, seen = 0;
+        char list[256];
+        snprintf(list, sizeof(list), "%s", selection);
+        for (char *token = strtok(list, ","); token; token = strtok(NULL, ","))
+        {
+            selected |= strstr(pv->name, token) != NULL;
+        }
+        for (int j = 0; j < num_pvars; j++)
+        {
+            seen |= strcmp(pvars[j].name, pv->name) == 0;
+        }
+        if (!selected || seen)
+        {
+            continue;
+        }
+
+        if (MPI_T_pvar_handle_alloc(pvar_session, i, bind == MPI_T_BIND_MPI_COMM ? &world : NULL,
+                                    &pv->handle, &pv->count) != MPI_SUCCESS)
+        {
+            continue;
+        }
+        if (pv->count < 1 || pv->count > MAX_PVAR_COUNT)
+        {
+            MPI_T_pvar_handle_free(pvar_session, &pv->handle);
+            continue;
+        }
+        if (!continuous)
+        {
+            MPI_T_pvar_start(pvar_session, pv->handle);
+        }
+        pv->is_delta = pv->var_class == MPI_T_PVAR_CLASS_COUNTER ||
+                       pv->var_class == MPI_T_PVAR_CLASS_AGGREGATE ||
+                       pv->var_class == MPI_T_PVAR_CLASS_TIMER;
+        num_pvars++;
+    }
+}
+
+static void pvar_finalize(void)
+{
+    if (!pvar_initialized)
+    {
+        return;
+    }
+    for (int i = 0; i < num_pvars; i++)
+    {
+        MPI_T_pvar_handle_free(pvar_session, &pvars[i].handle);
+    }
+    MPI_T_pvar_session_free(&pvar_session);
+    MPI_T_finalize();
+}
+
+// Read every selected pvar as one double (elements summed)
+static void pvar_read_all(double *values)
+{
+    for (int i = 0; i < num_pvars; i++)
+    {
+        const Pvar *pv = &pvars[i];
+        union
+        {
+            unsigned u[MAX_PVAR_COUNT];
+            unsigned long ul[MAX_PVAR_COUNT];
+            unsigned long long ull[MAX_PVAR_COUNT];
+            int i[MAX_PVAR_COUNT];
+            MPI_Count c[MAX_PVAR_COUNT];
+            double d[MAX_PVAR_COUNT];
+        } buffer;
+        values[i] = 0.0;
+        if (MPI_T_pvar_read(pvar_session, pv->handle, &buffer) != MPI_SUCCESS)
+        {
+            continue;
+        }
+        for (int e = 0; e < pv->count; e++)
+        {
+            if (pv->datatype == MPI_UNSIGNED)
+            {
+                values[i] += buffer.u[e];
+            }
+            else if (pv->datatype == MPI_UNSIGNED_LONG)
+            {
+                values[i] += buffer.ul[e];
+            }
+            else if (pv->datatype == MPI_UNSIGNED_LONG_LONG)
+            {
+                values[i] += buffer.ull[e];
+            }
+            else if (pv->datatype == MPI_INT)
+            {
+                values[i] += buffer.i[e];
+            }
+            else if (pv->datatype == MPI_COUNT)
+            {
+                values[i] += buffer.c[e];
+            }
+            else
+            {
+                values[i] += buffer.d[e];
+            }
+        }
+    }
+}
+
+// Run warmup and timed ping-pong iterations for one message size
+static void measure_size(int rank, int msg_size, char *send_buffer, char *recv_buffer,
+                         SizeResult *result)
+{
+    double pvar_before[MAX_PVARS];
+    pvar_read_all(pvar_before);
+
+    MPI_Status status;
+    double total_send_time = 0.0;
+    double total_recv_time = 0.0;
+    double total_rtt = 0.0;
+
+    // Warmup rounds (not timed) - helps stabilize measurements
+    for (int i = 0; i < WARMUP_ITERATIONS; i++)
+    {
+        if (rank == 0)
+        {
+            // Rank 0: Send then Receive (ping)
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD);
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &status);
+        }
+        else
+        {
+            // Rank 1: Receive then Send (pong)
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD, &status);
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+        }
+    }
+
+    // Synchronize before timing
+    sync_start(rank);
+
+    // Timed iterations
+    uint64_t t[2 * NUM_ITERATIONS + 1];
+    run_kernel(rank, COMM_MPI, msg_size, send_buffer, recv_buffer, NUM_ITERATIONS, t);
+
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        double first = ticks_to_us(t[2 * i + 1] - t[2 * i]);
+        double second = ticks_to_us(t[2 * i + 2] - t[2 * i + 1]);
+
+        if (rank == 0)
+        {
+            // Rank 0: PING (send) then receive PONG
+            total_send_time += first;
+            total_recv_time += second;
+            total_rtt += first + second;
+        }
+        else
+        {
+            // Rank 1: Receive PING then send PONG
+            total_recv_time += first;
+            total_send_time += second;
+        }
+    }
+
+    // Calculate averages
+    result->msg_size = msg_size;
+    result->avg_send = total_send_time / NUM_ITERATIONS;
+    result->avg_recv = total_recv_time / NUM_ITERATIONS;
+    result->avg_rtt = total_rtt / NUM_ITERATIONS;
+
+    // Calculate bandwidth (MB/s) using RTT (round-trip sends 2x the data)
+    // Bandwidth = (2 * msg_size) / RTT
+    result->bandwidth_mbps = 0.0;
+    if (result->avg_rtt > 0)
+    {
+        result->bandwidth_mbps = (2.0 * msg_size) / result->avg_rtt; // bytes/microsecond = MB/s
+    }
+
+    // Overhead-corrected copies: rank 0 times send then receive, rank 1 the reverse
+    const Calibration *cal = &calibration[timer_backend];
+    double send_overhead = (rank == 0) ? cal->first_us : cal->second_us;
+    double recv_overhead = (rank == 0) ? cal->second_us : cal->first_us;
+    result->corr_send = result->avg_send - send_overhead;
+    result->corr_recv = result->avg_recv - recv_overhead;
+    result->corr_rtt = result->avg_rtt - (cal->first_us + cal->second_us);
+    result->corr_bandwidth_mbps = 0.0;
+    if (result->corr_rtt > 0)
+    {
+        result->corr_bandwidth_mbps = (2.0 * msg_size) / result->corr_rtt;
+    }
+
+    // Library counters over the warmup and timed round trips, both ranks summed
+    if (num_pvars > 0)
+    {
+        double pvar_after[MAX_PVARS];
+        pvar_read_all(pvar_after);
+        for (int i = 0; i < num_pvars; i++)
+        {
+            pvar_after[i] = pvars[i].is_delta
+                                ? (pvar_after[i] - pvar_before[i]) /
+                                      (WARMUP_ITERATIONS + NUM_ITERATIONS)
+                                : pvar_after[i];
+        }
+        MPI_Reduce(pvar_after, result->pvar, num_pvars, MPI_DOUBLE, MPI_SUM, 0,
+                   MPI_COMM_WORLD);
+    }
+}
+
+static void print_header(FILE *outfile, const char *title)
+{
+    // Write CSV header
+    fprintf(outfile, "msg_size_bytes,avg_send_us,avg_recv_us,rtt_us,bandwidth_mbps,"
+                     "send_corrected_us,recv_corrected_us,rtt_corrected_us,"
+                     "bandwidth_corrected_mbps");
+    for (int i = 0; i < num_pvars; i++)
+    {
+        fprintf(outfile, ",%s", pvars[i].name);
+    }
+    fprintf(outfile, "\n");
+
+    // Print to console; pvars get short column labels with a legend
+    printf("%s (%d iterations, %d warmup)\n\n", title, NUM_ITERATIONS, WARMUP_ITERATIONS);
+    for (int i = 0; i < num_pvars; i++)
+    {
+        printf("  P%d = %s (%s)\n", i + 1, pvars[i].name,
+               pvars[i].is_delta ? "per round trip" : "value after size");
+    }
+    if (num_pvars > 0)
+    {
+        printf("\n");
+    }
+    printf("%10s %12s %12s %12s %12s %12s",
+           "Size (B)", "Send (us)", "Recv (us)", "RTT (us)", "BW (MB/s)", "RTT-cal (us)");
+    for (int i = 0; i < num_pvars; i++)
+    {
+        char label[16];
+        snprintf(label, sizeof(label), "P%d", i + 1);
+        printf(" %10s", label);
+    }
+    printf("\n---------- ------------ ------------ ------------ ------------ ------------");
+    for (int i = 0; i < num_pvars; i++)
+    {
+        printf(" ----------");
+    }
+    printf("\n");
+}
+
+static void print_row(FILE *outfile, const SizeResult *r)
+{
+    // Print to console
+    printf("%10d %12.2f %12.2f %12.2f %12.2f %12.2f",
+           r->msg_size, r->avg_send, r->avg_recv, r->avg_rtt, r->bandwidth_mbps, r->corr_rtt);
+    for (int i = 0; i < num_pvars; i++)
+    {
+        printf(" %10.4g", r->pvar[i]);
+    }
+    printf("\n");
+
+    // Write to CSV file
+    fprintf(outfile, "%d,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%.3f,%.2f",
+            r->msg_size, r->avg_send, r->avg_recv, r->avg_rtt, r->bandwidth_mbps,
+            r->corr_send, r->corr_recv, r->corr_rtt, r->corr_bandwidth_mbps);
+    for (int i = 0; i < num_pvars; i++)
+    {
+        fprintf(outfile, ",%.6g", r->pvar[i]);
+    }
+    fprintf(outfile, "\n");
+}
+
+// Derive latency, bandwidth and buffer size from a table sorted by size,
+// then print the summary and append it to the CSV file
+static void print_summary(FILE *outfile, const SizeResult *results, int count)
+{
+    double min_rtt = 1e9;         // For latency estimation (smallest RTT)
+    double max_bandwidth = 0.0;   // For bandwidth estimation (largest bandwidth)
+    int buffer_size_estimate = 0; // For buffer size detection
+    int buffer_detected = 0;      // Flag for buffer detection
+
+    for (int i = 0; i < count; i++)
+    {
+        const SizeResult *r = &results[i];
+
+        // Track minimum RTT (for latency - use small message sizes)
+        if (r->msg_size <= 64 && r->avg_rtt < min_rtt)
+        {
+            min_rtt = r->avg_rtt;
+        }
+
+        // Track maximum bandwidth (for bandwidth estimation)
+        if (r->bandwidth_mbps > max_bandwidth)
+        {
+            max_bandwidth = r->bandwidth_mbps;
+        }
+
+        // Detect buffer size: look for significant jump in send time
+        // When message exceeds buffer, MPI_Send blocks, causing longer send times
+        if (!buffer_detected && i > 0 && results[i - 1].avg_send > 0)
+        {
+            // If send time increases by more than 50%, buffer threshold likely exceeded
+            if (r->avg_send > results[i - 1].avg_send * 1.5 && r->msg_size >= 1024)
+            {
+                buffer_size_estimate = results[i - 1].msg_size; // Previous size was within buffer
+                buffer_detected = 1;
+            }
+        }
+    }
+
+    // Calculate derived estimates
+    double latency_estimate = min_rtt / 2.0;   // One-way latency from RTT
+    double bandwidth_estimate = max_bandwidth; // MB/s
+
+    // Print summary
+    printf("\n--- Results ---\n");
+    printf("Latency: %.2f us (RTT/2 for small msgs)\n", latency_estimate);
+    printf("Bandwidth: %.2f MB/s (max observed)\n", bandwidth_estimate);
+    if (buffer_detected)
+    {
+        printf("Buffer size: ~%d bytes\n", buffer_size_estimate);
+    }
+    else
+    {
+        printf("Buffer size: >1MB (no blocking seen)\n");
+    }
+    printf("\n");
+
+    // Write summary to CSV file
+    fprintf(outfile, "\n");
+    fprintf(outfile, "# Latency: %.2f us\n", latency_estimate);
+    fprintf(outfile, "# Bandwidth: %.2f MB/s\n", bandwidth_estimate);
+    if (buffer_detected)
+    {
+        fprintf(outfile, "# Buffer size: %d bytes\n", buffer_size_estimate);
+    }
+    else
+    {
+        fprintf(outfile, "# Buffer size: >1MB\n");
+    }
+
+    // Calibration metadata: overhead per timer and the correction applied
+    const Calibration *cal = &calibration[timer_backend];
+    printf("Harness overhead: %.3f us per round trip (%s timer, subtracted in RTT-cal)\n\n",
+           cal->first_us + cal->second_us, timer_names[timer_backend]);
+    for (int timer = 0; timer < NUM_TIMERS; timer++)
+    {
+        fprintf(outfile, "# Harness overhead %s: mean %.4f median %.4f p99 %.4f us\n",
+                timer_names[timer], calibration[timer].mean_us, calibration[timer].median_us,
+                calibration[timer].p99_us);
+    }
+    fprintf(outfile, "# Correction (%s): send %.4f recv %.4f rtt %.4f us\n",
+            timer_names[timer_backend], cal->first_us, cal->second_us,
+            cal->first_us + cal->second_us);
+
+    // Sizes where a library counter switches on or off, e.g. an eager count
+    // dropping to zero confirms the eager limit from the library itself
+    fprintf(outfile, "# MPI_T pvars: %d selected of %d available\n", num_pvars,
+            pvars_available);
+    for (int i = 0; i < num_pvars; i++)
+    {
+        for (int k = 1; k < count; k++)
+        {
+            int was_on = results[k - 1].pvar[i] != 0.0;
+            int is_on = results[k].pvar[i] != 0.0;
+            if (was_on != is_on)
+            {
+                printf("%s %s between %d and %d bytes\n", pvars[i].name,
+                       is_on ? "becomes nonzero" : "drops to zero", results[k - 1].msg_size,
+                       results[k].msg_size);
+                fprintf(outfile, "# pvar %s %s between %d and %d bytes\n", pvars[i].name,
+                        is_on ? "becomes nonzero" : "drops to zero", results[k - 1].msg_size,
+                        results[k].msg_size);
+            }
+        }
+    }
+}
+
+// Power-of-two sweep: 1, 2, 4, 8, ..., 1MB
+static int run_sweep(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", OUTPUT_FILE);
+
+    // Open output file and print headers (rank 0 only)
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            return 1;
+        }
+        print_header(outfile, "Ping-Pong Test");
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, MAX_MSG_SIZE, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+
+    calibrate_harness(rank);
+
+    SizeResult results[32];
+    int count = 0;
+
+    // Iterate over message sizes (1, 2, 4, 8, ..., 1MB)
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= MAX_MSG_SIZE; msg_size *= 2)
+    {
+        SizeResult *r = &results[count++];
+        measure_size(rank, msg_size, send_buffer, recv_buffer, r);
+
+        // Only rank 0 prints and saves results
+        if (rank == 0)
+        {
+            print_row(outfile, r);
+        }
+
+        // Synchronize before next message size
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    // Print footer with analysis hints and close file
+    if (rank == 0)
+    {
+        print_summary(outfile, results, count);
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+static int compare_size(const void *a, const void *b)
+{
+    return ((const SizeResult *)a)->msg_size - ((const SizeResult *)b)->msg_size;
+}
+
+// Mark the coarse intervals [i, i+1] that contain a discontinuity.
+// RTT = a + n/b is linear in n, so on a smooth curve each point lies on the
+// chord between its neighbours; a protocol switch pushes it off the chord.
+// A drop in bandwidth or a jump in send time between neighbours also counts.
+static void find_discontinuities(const SizeResult *coarse, int count, double threshold,
+                                 int *flagged)
+{
+    for (int i = 0; i < count - 1; i++)
+    {
+        flagged[i] = 0;
+    }
+
+    for (int i = 0; i < count - 1; i++)
+    {
+        const SizeResult *lo = &coarse[i];
+        const SizeResult *hi = &coarse[i + 1];
+
+        if (hi->bandwidth_mbps < lo->bandwidth_mbps * (1.0 - threshold))
+        {
+            flagged[i] = 1;
+        }
+        if (hi->avg_send > lo->avg_send * 1.5 && hi->avg_send - lo->avg_send > 1.0)
+        {
+            flagged[i] = 1;
+        }
+
+        if (i > 0)
+        {
+            const SizeResult *prev = &coarse[i - 1];
+            double frac = (double)(lo->msg_size - prev->msg_size) /
+                          (double)(hi->msg_size - prev->msg_size);
+            double chord = prev->avg_rtt + frac * (hi->avg_rtt - prev->avg_rtt);
+            if (chord > 0 && (lo->avg_rtt - chord) / chord > threshold)
+            {
+                flagged[i - 1] = 1;
+                flagged[i] = 1;
+            }
+        }
+    }
+}
+
+// Coarse log sweep, then dense linear steps inside every interval where the
+// curve shows a discontinuity. The merged table is sorted by size.
+static int run_refine(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", OUTPUT_FILE);
+    int steps = (int)opt_long(argc, argv, "refine-steps", REFINE_STEPS);
+    double threshold = opt_double(argc, argv, "refine-threshold", REFINE_THRESHOLD);
+
+    if (steps < 1)
+    {
+        steps = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, MAX_MSG_SIZE, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+
+    calibrate_harness(rank);
+
+    // Coarse pass: 1, 2, 4, ..., 1MB
+    int coarse_count = 0;
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= MAX_MSG_SIZE; msg_size *= 2)
+    {
+        coarse_count++;
+    }
+
+    int max_count = coarse_count + (coarse_count - 1) * (steps - 1);
+    SizeResult *results = (SizeResult *)malloc(max_count * sizeof(SizeResult));
+    int *plan = (int *)malloc(max_count * sizeof(int));
+    int *flagged = (int *)malloc(coarse_count * sizeof(int));
+
+    int count = 0;
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= MAX_MSG_SIZE; msg_size *= 2)
+    {
+        measure_size(rank, msg_size, send_buffer, recv_buffer, &results[count++]);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    // Rank 0 plans the refinement sizes and shares them with rank 1
+    int plan_count = 0;
+    if (rank == 0)
+    {
+        find_discontinuities(results, coarse_count, threshold, flagged);
+        for (int i = 0; i < coarse_count - 1; i++)
+        {
+            if (!flagged[i])
+            {
+                continue;
+            }
+
+            int lo = results[i].msg_size;
+            int hi = results[i + 1].msg_size;
+            int stride = (hi - lo + steps - 1) / steps; // At most steps-1 new sizes
+            for (int size = lo + stride; size < hi; size += stride)
+            {
+                plan[plan_count++] = size;
+            }
+        }
+    }
+    MPI_Bcast(&plan_count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(plan, plan_count, MPI_INT, 0, MPI_COMM_WORLD);
+
+    // Refinement pass
+    for (int i = 0; i < plan_count; i++)
+    {
+        measure_size(rank, plan[i], send_buffer, recv_buffer, &results[count++]);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    // Merge, sort and write the table (rank 0 only)
+    int status = 0;
+    if (rank == 0)
+    {
+        qsort(results, count, sizeof(SizeResult), compare_size);
+
+        FILE *outfile = open_output(out_path);
+        if (outfile)
+        {
+            print_header(outfile, "Ping-Pong Refined Sweep");
+            for (int i = 0; i < count; i++)
+            {
+                print_row(outfile, &results[i]);
+            }
+            print_summary(outfile, results, count);
+            fprintf(outfile, "# Refined sizes: %d (threshold %.2f, %d steps)\n",
+                    plan_count, threshold, steps);
+            fclose(outfile);
+            printf("Refined %d sizes around discontinuities\n", plan_count);
+            printf("Saved to %s\n", out_path);
+        }
+        else
+        {
+            status = 1;
+        }
+    }
+
+    // Cleanup
+    free(results);
+    free(plan);
+    free(flagged);
+    free(send_buffer);
+    free(recv_buffer);
+    return status;
+}
+
+// Best single step in a window: the split that minimizes the squared error of
+// a two-level fit. Returns the index of the first size after the step, or -1
+// if the jump is not significant at the requested number of standard errors.
+static int detect_step(const double *rtt, int n, double sigma, double *jump)
+{
+    int best = -1;
+    double best_sse = 0.0;
+    double best_jump = 0.0;
+
+    for (int k = 2; k <= n - 2; k++)
+    {
+        double left = 0.0, right = 0.0;
+        for (int j = 0; j < k; j++)
+        {
+            left += rtt[j];
+        }
+        for (int j = k; j < n; j++)
+        {
+            right += rtt[j];
+        }
+        left /= k;
+        right /= (n - k);
+
+        double sse = 0.0;
+        for (int j = 0; j < n; j++)
+        {
+            double d = rtt[j] - (j < k ? left : right);
+            sse += d * d;
+        }
+        if (best < 0 || sse < best_sse)
+        {
+            best = k;
+            best_sse = sse;
+            best_jump = right - left;
+        }
+    }
+
+    if (best < 0 || best_jump <= 0)
+    {
+        return -1;
+    }
+
+    // Standard error of the difference between the two level means
+    double noise = n > 2 ? sqrt(best_sse / (n - 2)) : 0.0;
+    double stderr_jump = noise * sqrt(1.0 / best + 1.0 / (n - best));
+    *jump = best_jump;
+    return (best_jump > sigma * stderr_jump) ? best : -1;
+}
+
+// Probe byte-granular windows around suspected packet boundaries, locate the
+// latency steps and infer the effective payload carried per packet
+static int run_mtu(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_mtu.csv");
+    int window = (int)opt_long(argc, argv, "window", MTU_WINDOW);
+    int step = (int)opt_long(argc, argv, "step", 1);
+    int iterations = (int)opt_long(argc, argv, "iterations", NUM_ITERATIONS);
+    double sigma = opt_double(argc, argv, "sigma", MTU_SIGMA);
+
+    int centers[MAX_LIST];
+    int num_centers = parse_int_list(opt_str(argc, argv, "boundaries", MTU_BOUNDARIES),
+                                     centers, MAX_LIST);
+    if (step < 1)
+    {
+        step = 1;
+    }
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    int max_size = 0;
+    for (int c = 0; c < num_centers; c++)
+    {
+        if (centers[c] + window > max_size)
+        {
+            max_size = centers[c] + window;
+        }
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            free(send_buffer);
+            free(recv_buffer);
+            return 1;
+        }
+        fprintf(outfile, "boundary_bytes,msg_size_bytes,median_rtt_us,min_rtt_us,avg_rtt_us\n");
+        printf("MTU Boundary Probe (%d iterations, window +/-%d, step %d)\n\n",
+               iterations, window, step);
+        printf("%10s %10s %12s %12s\n", "Boundary", "Step at", "Before (us)", "Jump (us)");
+        printf("---------- ---------- ------------ ------------\n");
+    }
+
+    int points = 2 * window / step + 1;
+    double *samples = (double *)malloc(iterations * sizeof(double));
+    double *medians = (double *)malloc(points * sizeof(double));
+    int *sizes = (int *)malloc(points * sizeof(int));
+    int steps_found[MAX_LIST];
+    int num_steps = 0;
+
+    for (int c = 0; c < num_centers; c++)
+    {
+        int n = 0;
+        for (int size = centers[c] - window; size <= centers[c] + window; size += step)
+        {
+            if (size < 1)
+            {
+                continue;
+            }
+            pingpong_samples(rank, size, send_buffer, recv_buffer, iterations, samples);
+            if (rank == 0)
+            {
+                Stats stats;
+                compute_stats(samples, iterations, &stats);
+                fprintf(outfile, "%d,%d,%.3f,%.3f,%.3f\n",
+                        centers[c], size, stats.median, stats.min, stats.mean);
+                sizes[n] = size;
+                medians[n] = stats.median;
+            }
+            n++;
+        }
+
+        if (rank == 0)
+        {
+            double jump = 0.0;
+            int k = detect_step(medians, n, sigma, &jump);
+            if (k > 0)
+            {
+                // Last size that still fits in the smaller packet count
+                steps_found[num_steps++] = sizes[k - 1];
+                printf("%10d %10d %12.3f %12.3f\n", centers[c], sizes[k - 1],
+                       medians[k - 1], jump);
+            }
+            else
+            {
+                printf("%10d %10s %12s %12s\n", centers[c], "-", "-", "-");
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (rank == 0)
+    {
+        // Steps sit at multiples of the payload; the smallest spacing gives a
+        // first guess, a least-squares fit through the origin refines it
+        double payload = 0.0;
+        if (num_steps == 1)
+        {
+            payload = steps_found[0];
+        }
+        else if (num_steps > 1)
+        {
+            int spacing = steps_found[num_steps - 1];
+            for (int i = 1; i < num_steps; i++)
+            {
+                int d = steps_found[i] - steps_found[i - 1];
+                if (d > 0 && d < spacing)
+                {
+                    spacing = d;
+                }
+            }
+            if (steps_found[0] < spacing)
+            {
+                spacing = steps_found[0];
+            }
+
+            double num = 0.0, den = 0.0;
+            for (int i = 0; i < num_steps; i++)
+            {
+                double packets = floor((double)steps_found[i] / spacing + 0.5);
+                num += packets * steps_found[i];
+                den += packets * packets;
+            }
+            payload = num / den;
+        }
+
+        printf("\n--- Results ---\n");
+        printf("Steps detected: %d of %d windows\n", num_steps, num_centers);
+        fprintf(outfile, "\n# Steps detected: %d of %d windows\n", num_steps, num_centers);
+        if (num_steps > 0)
+        {
+            printf("Effective payload per packet: ~%.0f bytes\n", payload);
+            fprintf(outfile, "# Effective payload per packet: %.0f bytes\n", payload);
+        }
+        else
+        {
+            printf("Effective payload per packet: not detected\n");
+            fprintf(outfile, "# Effective payload per packet: not detected\n");
+        }
+        printf("\n");
+
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(samples);
+    free(medians);
+    free(sizes);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Estimate each rank's clock offset from rank 0 (rank 0 fills offsets[r]).
+// Uses the exchange with the smallest round trip, where the midpoint of
+// rank 0's send and receive times best matches the remote timestamp.
+static void estimate_clock_offsets(int rank, int num_procs, double *offsets)
+{
+    for (int r = 1; r < num_procs; r++)
+    {
+        double best_rtt = 1e30;
+        double remote = 0.0;
+
+        for (int i = 0; i < OFFSET_PINGS; i++)
+        {
+            if (rank == 0)
+            {
+                double t_send = get_time_us();
+                MPI_Send(&t_send, 1, MPI_DOUBLE, r, 2, MPI_COMM_WORLD);
+                MPI_Recv(&remote, 1, MPI_DOUBLE, r, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                double t_recv = get_time_us();
+
+                if (t_recv - t_send < best_rtt)
+                {
+                    best_rtt = t_recv - t_send;
+                    offsets[r] = remote - (t_send + t_recv) / 2.0;
+                }
+            }
+            else if (rank == r)
+            {
+                MPI_Recv(&remote, 1, MPI_DOUBLE, 0, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                remote = get_time_us();
+                MPI_Send(&remote, 1, MPI_DOUBLE, 0, 2, MPI_COMM_WORLD);
+            }
+        }
+    }
+    if (rank == 0)
+    {
+        offsets[0] = 0.0;
+    }
+}
+
+// MPI_Barrier latency and exit-time skew across process counts 2, 4, ..., N.
+// Exit timestamps are corrected with the estimated clock offsets so the skew
+// is the spread between the first and last rank leaving the barrier.
+static int run_barrier(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_barrier.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", BARRIER_ITERATIONS);
+
+    enum
+    {
+        BARRIER_SINGLE, // One MPI_Barrier per sample
+        BARRIER_DOUBLE, // Two back-to-back barriers per sample
+        NUM_BARRIER_METHODS
+    };
+    const char *method_names[NUM_BARRIER_METHODS] = {"barrier", "double"};
+
+    if (num_procs < 2)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: barrier mode requires at least 2 processes.\n");
+        }
+        return 1;
+    }
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    double *offsets = (double *)calloc(num_procs, sizeof(double));
+    estimate_clock_offsets(rank, num_procs, offsets);
+
+    double *latency = (double *)malloc(iterations * sizeof(double));
+    double *exits = (double *)malloc(iterations * sizeof(double));
+    double *all_latency = NULL;
+    double *all_exits = NULL;
+    double *skew = NULL;
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        all_latency = (double *)malloc((size_t)iterations * num_procs * sizeof(double));
+        all_exits = (double *)malloc((size_t)iterations * num_procs * sizeof(double));
+        skew = (double *)malloc(iterations * sizeof(double));
+
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "procs,method,median_latency_us,p99_latency_us,"
+                         "median_skew_us,p99_skew_us,max_skew_us\n");
+        printf("Barrier Latency and Exit Skew (%d iterations)\n\n", iterations);
+        printf("%6s %8s %12s %12s %12s %12s\n",
+               "Procs", "Method", "Median (us)", "p99 (us)", "Skew (us)", "Skew p99");
+        printf("------ -------- ------------ ------------ ------------ ------------\n");
+    }
+
+    int procs = 2;
+    while (1)
+    {
+        // Sub-communicator holding the first procs ranks
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < procs ? 0 : MPI_UNDEFINED, rank, &comm);
+
+        for (int method = 0; method < NUM_BARRIER_METHODS; method++)
+        {
+            if (comm != MPI_COMM_NULL)
+            {
+                // Warmup
+                for (int i = 0; i < WARMUP_ITERATIONS; i++)
+                {
+                    MPI_Barrier(comm);
+                }
+
+                for (int i = 0; i < iterations; i++)
+                {
+                    double t_start = get_time_us();
+                    MPI_Barrier(comm);
+                    if (method == BARRIER_DOUBLE)
+                    {
+                        MPI_Barrier(comm);
+                    }
+                    exits[i] = get_time_us();
+                    latency[i] = exits[i] - t_start;
+                }
+
+                MPI_Gather(latency, iterations, MPI_DOUBLE,
+                           all_latency, iterations, MPI_DOUBLE, 0, comm);
+                MPI_Gather(exits, iterations, MPI_DOUBLE,
+                           all_exits, iterations, MPI_DOUBLE, 0, comm);
+            }
+
+            if (rank == 0)
+            {
+                for (int i = 0; i < iterations; i++)
+                {
+                    double first = 1e300, last = -1e300;
+                    for (int r = 0; r < procs; r++)
+                    {
+                        double t = all_exits[(size_t)r * iterations + i] - offsets[r];
+                        first = t < first ? t : first;
+                        last = t > last ? t : last;
+                    }
+                    skew[i] = last - first;
+                }
+
+                Stats lat_stats, skew_stats;
+                compute_stats(all_latency, iterations * procs, &lat_stats);
+                compute_stats(skew, iterations, &skew_stats);
+
+                printf("%6d %8s %12.2f %12.2f %12.2f %12.2f\n", procs, method_names[method],
+                       lat_stats.median, lat_stats.p99, skew_stats.median, skew_stats.p99);
+                fprintf(outfile, "%d,%s,%.3f,%.3f,%.3f,%.3f,%.3f\n", procs,
+                        method_names[method], lat_stats.median, lat_stats.p99,
+                        skew_stats.median, skew_stats.p99, skew_stats.max);
+            }
+        }
+
+        if (comm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&comm);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        if (procs == num_procs)
+        {
+            break;
+        }
+        procs = (procs * 2 > num_procs) ? num_procs : procs * 2;
+    }
+
+    if (rank == 0)
+    {
+        fprintf(outfile, "\n# Clock offsets (us, relative to rank 0):");
+        for (int r = 1; r < num_procs; r++)
+        {
+            fprintf(outfile, " %.2f", offsets[r]);
+        }
+        fprintf(outfile, "\n");
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(offsets);
+    free(latency);
+    free(exits);
+    free(all_latency);
+    free(all_exits);
+    free(skew);
+    return 0;
+}
+
+// Rounds in a round-robin schedule where every pair of ranks meets once
+static int pair_rounds(int num_procs)
+{
+    return (num_procs % 2) ? num_procs : num_procs - 1;
+}
+
+// Partner of rank in the given round (circle method), or -1 for a bye.
+// Rank `ring` takes the circle position that would pair with itself, so
+// both sides of every pair name each other and each rank has at most one
+// partner per round; a round's blocking exchanges therefore cannot deadlock.
+static int pair_partner(int rank, int num_procs, int round)
+{
+    int slots = (num_procs % 2) ? num_procs + 1 : num_procs;
+    int ring = slots - 1;
+    int partner;
+
+    if (rank == ring)
+    {
+        partner = round % ring; // The rank whose circle slot maps to itself this round
+    }
+    else
+    {
+        partner = ((2 * round - rank) % ring + ring) % ring;
+        if (partner == rank)
+        {
+            partner = ring;
+        }
+    }
+    return (partner >= num_procs) ? -1 : partner;
+}
+
+// One 1-byte exchange with partner. The initiator returns the RTT; the lower
+// rank initiates when the pair's sum is even so every rank times about half
+// of its contacts.
+static double contact_peer(int rank, int partner, int tag)
+{
+    char byte = 0;
+
+    if ((rank < partner) == ((rank + partner) % 2 == 0))
+    {
+        double t_start = get_time_us();
+        MPI_Send(&byte, 1, MPI_BYTE, partner, tag, MPI_COMM_WORLD);
+        MPI_Recv(&byte, 1, MPI_BYTE, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        return get_time_us() - t_start;
+    }
+
+    MPI_Recv(&byte, 1, MPI_BYTE, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Send(&byte, 1, MPI_BYTE, partner, tag, MPI_COMM_WORLD);
+    return -1.0;
+}
+
+// Print min/median/max/mean of one per-rank metric across all ranks
+static void print_rank_distribution(FILE *outfile, const char *metric, double *values, int n)
+{
+    Stats stats;
+    compute_stats(values, n, &stats);
+    printf("%-18s %12.1f %12.1f %12.1f %12.1f\n",
+           metric, stats.min, stats.median, stats.max, stats.mean);
+    fprintf(outfile, "# %s: min %.1f median %.1f max %.1f mean %.1f us\n",
+            metric, stats.min, stats.median, stats.max, stats.mean);
+}
+
+// Startup costs: exec-to-main, MPI_Init, first message to every peer, and
+// communicator creation. Each rank times its own share and rank 0 gathers
+// the per-rank values. First contacts run before the communicator calls by
+// default because those calls open connections of their own.
+static int run_startup(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_startup.csv");
+    int comm_first = (int)opt_long(argc, argv, "comm-first", 0);
+
+    enum
+    {
+        EXEC_TO_MAIN,
+        INIT,
+        FIRST_MSG_MEAN,
+        FIRST_MSG_MAX,
+        FULL_MESH,
+        COMM_DUP,
+        COMM_SPLIT,
+        COMM_SPLIT_TYPE,
+        NUM_METRICS
+    };
+    const char *names[NUM_METRICS] = {"exec_to_main", "init", "first_msg_mean",
+                                      "first_msg_max", "full_mesh", "comm_dup",
+                                      "comm_split", "comm_split_type"};
+    double local[NUM_METRICS] = {0};
+
+    local[EXEC_TO_MAIN] = startup_exec_us;
+    local[INIT] = startup_init_us;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if ((pass == 0) == (comm_first != 0))
+        {
+            // Communicator creation, each call timed on first use
+            MPI_Comm dup, split, node;
+            double t0 = get_time_us();
+            MPI_Comm_dup(MPI_COMM_WORLD, &dup);
+            double t1 = get_time_us();
+            MPI_Comm_split(MPI_COMM_WORLD, rank % 2, rank, &split);
+            double t2 = get_time_us();
+            MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+            double t3 = get_time_us();
+
+            local[COMM_DUP] = t1 - t0;
+            local[COMM_SPLIT] = t2 - t1;
+            local[COMM_SPLIT_TYPE] = t3 - t2;
+
+            MPI_Comm_free(&dup);
+            MPI_Comm_free(&split);
+            MPI_Comm_free(&node);
+        }
+        else
+        {
+            // First message to every peer, one partner per round
+            double sum = 0.0, max = 0.0;
+            int contacts = 0;
+            double t_mesh = get_time_us();
+            for (int round = 0; round < pair_rounds(num_procs); round++)
+            {
+                int partner = pair_partner(rank, num_procs, round);
+                if (partner < 0)
+                {
+                    continue;
+                }
+                double rtt = contact_peer(rank, partner, 3);
+                if (rtt >= 0)
+                {
+                    sum += rtt;
+                    max = rtt > max ? rtt : max;
+                    contacts++;
+                }
+            }
+            local[FULL_MESH] = get_time_us() - t_mesh;
+            local[FIRST_MSG_MEAN] = contacts ? sum / contacts : 0.0;
+            local[FIRST_MSG_MAX] = max;
+        }
+    }
+
+    double *all = NULL;
+    if (rank == 0)
+    {
+        all = (double *)malloc((size_t)num_procs * NUM_METRICS * sizeof(double));
+    }
+    MPI_Gather(local, NUM_METRICS, MPI_DOUBLE, all, NUM_METRICS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        FILE *outfile = open_output(out_path);
+        if (!outfile)
+        {
+            free(all);
+            return 1;
+        }
+
+        // Per-rank table
+        fprintf(outfile, "rank");
+        for (int m = 0; m < NUM_METRICS; m++)
+        {
+            fprintf(outfile, ",%s_us", names[m]);
+        }
+        fprintf(outfile, "\n");
+        for (int r = 0; r < num_procs; r++)
+        {
+            fprintf(outfile, "%d", r);
+            for (int m = 0; m < NUM_METRICS; m++)
+            {
+                fprintf(outfile, ",%.1f", all[(size_t)r * NUM_METRICS + m]);
+            }
+            fprintf(outfile, "\n");
+        }
+        fprintf(outfile, "\n");
+
+        printf("MPI Startup Costs (%d ranks, thread level %d)\n\n", num_procs, thread_provided);
+        printf("%-18s %12s %12s %12s %12s\n", "Metric", "Min (us)", "Median (us)",
+               "Max (us)", "Mean (us)");
+        printf("------------------ ------------ ------------ ------------ ------------\n");
+
+        // Distribution across ranks, one metric at a time
+        double *column = (double *)malloc(num_procs * sizeof(double));
+        for (int m = 0; m < NUM_METRICS; m++)
+        {
+            for (int r = 0; r < num_procs; r++)
+            {
+                column[r] = all[(size_t)r * NUM_METRICS + m];
+            }
+            print_rank_distribution(outfile, names[m], column, num_procs);
+        }
+        free(column);
+
+        if (startup_exec_us < 0)
+        {
+            printf("(exec_to_main unavailable on this platform)\n");
+        }
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    free(all);
+    return 0;
+}
+
+// First contact versus steady state for every pair of ranks. Rounds of the
+// pair schedule are shuffled with a seed every rank shares, so each rank
+// meets its peers in a random order without any communication beforehand;
+// nothing (not even a barrier) runs before the first pass.
+static int run_mesh(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_mesh.csv");
+    int repeats = (int)opt_long(argc, argv, "repeats", MESH_REPEATS);
+    unsigned long long seed = (unsigned long long)opt_long(argc, argv, "seed", DEFAULT_SEED);
+
+    if (num_procs < 2)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: mesh mode requires at least 2 processes.\n");
+        }
+        return 1;
+    }
+    if (repeats < 1)
+    {
+        repeats = 1;
+    }
+
+    // Shuffled round order (Fisher-Yates)
+    int rounds = pair_rounds(num_procs);
+    int *order = (int *)malloc(rounds * sizeof(int));
+    for (int i = 0; i < rounds; i++)
+    {
+        order[i] = i;
+    }
+    unsigned long long state = seed ? seed : DEFAULT_SEED;
+    for (int i = rounds - 1; i > 0; i--)
+    {
+        int j = (int)(next_random(&state) % (unsigned long long)(i + 1));
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    // first[p] and steady[p] hold this rank's RTT to peer p when it initiated
+    double *first = (double *)malloc(num_procs * sizeof(double));
+    double *steady = (double *)malloc(num_procs * sizeof(double));
+    double *repeat_rtt = (double *)malloc((size_t)num_procs * repeats * sizeof(double));
+    for (int p = 0; p < num_procs; p++)
+    {
+        first[p] = -1.0;
+        steady[p] = -1.0;
+    }
+
+    double t_mesh = get_time_us();
+    for (int i = 0; i < rounds; i++)
+    {
+        int partner = pair_partner(rank, num_procs, order[i]);
+        if (partner >= 0)
+        {
+            first[partner] = contact_peer(rank, partner, 4);
+        }
+    }
+    double mesh_time = get_time_us() - t_mesh;
+
+    for (int k = 0; k < repeats; k++)
+    {
+        for (int i = 0; i < rounds; i++)
+        {
+            int partner = pair_partner(rank, num_procs, order[i]);
+            if (partner >= 0)
+            {
+                repeat_rtt[(size_t)partner * repeats + k] = contact_peer(rank, partner, 4);
+            }
+        }
+    }
+    for (int p = 0; p < num_procs; p++)
+    {
+        if (first[p] >= 0)
+        {
+            Stats stats;
+            compute_stats(&repeat_rtt[(size_t)p * repeats], repeats, &stats);
+            steady[p] = stats.median;
+        }
+    }
+
+    double *all_first = NULL, *all_steady = NULL, *all_mesh = NULL;
+    if (rank == 0)
+    {
+        all_first = (double *)malloc((size_t)num_procs * num_procs * sizeof(double));
+        all_steady = (double *)malloc((size_t)num_procs * num_procs * sizeof(double));
+        all_mesh = (double *)malloc(num_procs * sizeof(double));
+    }
+    MPI_Gather(first, num_procs, MPI_DOUBLE, all_first, num_procs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(steady, num_procs, MPI_DOUBLE, all_steady, num_procs, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+    MPI_Gather(&mesh_time, 1, MPI_DOUBLE, all_mesh, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    int status = 0;
+    if (rank == 0)
+    {
+        FILE *outfile = open_output(out_path);
+        if (outfile)
+        {
+            int pairs = num_procs * (num_procs - 1) / 2;
+            double *overhead = (double *)malloc(pairs * sizeof(double));
+            double *first_rtt = (double *)malloc(pairs * sizeof(double));
+            double *steady_rtt = (double *)malloc(pairs * sizeof(double));
+            int n = 0;
+
+            fprintf(outfile, "initiator,peer,first_rtt_us,steady_rtt_us,overhead_us\n");
+            for (int r = 0; r < num_procs; r++)
+            {
+                for (int p = 0; p < num_procs; p++)
+                {
+                    double f = all_first[(size_t)r * num_procs + p];
+                    double st = all_steady[(size_t)r * num_procs + p];
+                    if (f < 0)
+                    {
+                        continue;
+                    }
+                    fprintf(outfile, "%d,%d,%.2f,%.2f,%.2f\n", r, p, f, st, f - st);
+                    first_rtt[n] = f;
+                    steady_rtt[n] = st;
+                    overhead[n] = f - st;
+                    n++;
+                }
+            }
+
+            Stats first_stats, steady_stats, overhead_stats, mesh_stats;
+            compute_stats(first_rtt, n, &first_stats);
+            compute_stats(steady_rtt, n, &steady_stats);
+            compute_stats(overhead, n, &overhead_stats);
+            compute_stats(all_mesh, num_procs, &mesh_stats);
+
+            printf("First Contact vs Steady State (%d ranks, %d pairs, %d repeats)\n\n",
+                   num_procs, n, repeats);
+            printf("%-16s %12s %12s %12s %12s\n", "Metric", "Min (us)", "Median (us)",
+                   "p99 (us)", "Max (us)");
+            printf("---------------- ------------ ------------ ------------ ------------\n");
+            printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", "first_rtt",
+                   first_stats.min, first_stats.median, first_stats.p99, first_stats.max);
+            printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", "steady_rtt",
+                   steady_stats.min, steady_stats.median, steady_stats.p99, steady_stats.max);
+            printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", "setup_overhead",
+                   overhead_stats.min, overhead_stats.median, overhead_stats.p99,
+                   overhead_stats.max);
+            printf("%-16s %12.2f %12.2f %12.2f %12.2f\n", "time_to_mesh",
+                   mesh_stats.min, mesh_stats.median, mesh_stats.p99, mesh_stats.max);
+
+            printf("\n--- Results ---\n");
+            printf("Connection setup overhead: %.2f us median per peer\n", overhead_stats.median);
+            printf("Time to full mesh: %.2f us (slowest rank)\n", mesh_stats.max);
+            printf("\n");
+
+            fprintf(outfile, "\n# Setup overhead: min %.2f median %.2f p99 %.2f max %.2f us\n",
+                    overhead_stats.min, overhead_stats.median, overhead_stats.p99,
+                    overhead_stats.max);
+            fprintf(outfile, "# Time to full mesh: %.2f us (slowest rank)\n", mesh_stats.max);
+            fprintf(outfile, "# Seed: %llu\n", seed);
+            fclose(outfile);
+            printf("Saved to %s\n", out_path);
+
+            free(overhead);
+            free(first_rtt);
+            free(steady_rtt);
+        }
+        else
+        {
+            status = 1;
+        }
+    }
+
+    // Cleanup
+    free(order);
+    free(first);
+    free(steady);
+    free(repeat_rtt);
+    free(all_first);
+    free(all_steady);
+    free(all_mesh);
+    return status;
+}
+
+// Latency versus CPU cost for each receive wait strategy. Both ranks use the
+// same strategy; per-iteration thread CPU time comes from
+// CLOCK_THREAD_CPUTIME_ID and whole-process CPU (progress threads included)
+// from getrusage around the timed loop.
+static int run_cpucost(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_cpucost.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", NUM_ITERATIONS);
+    int max_size = (int)opt_long(argc, argv, "max-size", MAX_MSG_SIZE);
+    int peer = 1 - rank;
+
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+
+    double *rtt = (double *)malloc(iterations * sizeof(double));
+    double *cpu = (double *)malloc(iterations * sizeof(double));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,strategy,median_rtt_us,p99_rtt_us,"
+                         "thread_cpu_us,process_cpu_us,peer_process_cpu_us,cpu_per_wall\n");
+        printf("Receive Strategy CPU Cost (%d iterations)\n\n", iterations);
+        printf("%10s %8s %12s %12s %12s %12s %10s\n", "Size (B)", "Wait", "RTT (us)",
+               "p99 (us)", "Thread CPU", "Proc CPU", "CPU/Wall");
+        printf("---------- -------- ------------ ------------ ------------ ------------ "
+               "----------\n");
+    }
+
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+    {
+        for (int strategy = 0; strategy < NUM_WAITS; strategy++)
+        {
+            // Warmup rounds (not timed)
+            for (int i = 0; i < WARMUP_ITERATIONS; i++)
+            {
+                if (rank == 0)
+                {
+                    MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+                    recv_with(strategy, recv_buffer, msg_size, peer, 0, MPI_COMM_WORLD);
+                }
+                else
+                {
+                    recv_with(strategy, recv_buffer, msg_size, peer, 0, MPI_COMM_WORLD);
+                    MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+                }
+            }
+
+            sync_start(rank);
+
+            double proc_start = process_cpu_us();
+            double wall_start = get_time_us();
+            for (int i = 0; i < iterations; i++)
+            {
+                double cpu_start = thread_cpu_us();
+                double t_start = get_time_us();
+                if (rank == 0)
+                {
+                    MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+                    recv_with(strategy, recv_buffer, msg_size, peer, 0, MPI_COMM_WORLD);
+                }
+                else
+                {
+                    recv_with(strategy, recv_buffer, msg_size, peer, 0, MPI_COMM_WORLD);
+                    MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+                }
+                rtt[i] = get_time_us() - t_start;
+                cpu[i] = thread_cpu_us() - cpu_start;
+            }
+            double wall = get_time_us() - wall_start;
+            double proc_cpu = (process_cpu_us() - proc_start) / iterations;
+
+            // Rank 1 reports its own process CPU per iteration
+            double peer_cpu = 0.0;
+            if (rank == 0)
+            {
+                MPI_Recv(&peer_cpu, 1, MPI_DOUBLE, peer, 5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+                Stats rtt_stats, cpu_stats;
+                compute_stats(rtt, iterations, &rtt_stats);
+                compute_stats(cpu, iterations, &cpu_stats);
+                double cpu_per_wall = wall > 0 ? cpu_stats.mean * iterations / wall : 0.0;
+
+                printf("%10d %8s %12.2f %12.2f %12.2f %12.2f %10.2f\n", msg_size,
+                       wait_names[strategy], rtt_stats.median, rtt_stats.p99, cpu_stats.mean,
+                       proc_cpu, cpu_per_wall);
+                fprintf(outfile, "%d,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", msg_size,
+                        wait_names[strategy], rtt_stats.median, rtt_stats.p99, cpu_stats.mean,
+                        proc_cpu, peer_cpu, cpu_per_wall);
+            }
+            else
+            {
+                MPI_Send(&proc_cpu, 1, MPI_DOUBLE, peer, 5, MPI_COMM_WORLD);
+            }
+
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(rtt);
+    free(cpu);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Queue positions a match-mode ping can be matched at
+enum
+{
+    MATCH_HEAD,
+    MATCH_MIDDLE,
+    MATCH_TAIL,
+    NUM_MATCH_POSITIONS
+};
+
+// Ping-pong whose ping has to be matched against a queue of depth entries.
+//
+// Posted queue: rank 1 keeps depth receives posted with distinct tags and the
+// ping carries the tag sitting at the requested position. The matched receive
+// is reposted at the tail before the pong goes out; both ranks replay the
+// same reordering so rank 0 always knows which tag is at that position.
+//
+// Unexpected queue: rank 0 first leaves depth never-received messages in
+// rank 1's unexpected queue, so every receive rank 1 posts for the ping scans
+// all of them (the ping always matches behind the queue, at the tail).
+//
+// With wildcard set the receives use MPI_ANY_SOURCE.
+static void match_pingpong(int rank, int depth, int position, int wildcard, int unexpected,
+                           int msg_size, int iterations, double *rtt)
+{
+    int peer = 1 - rank;
+    int source = wildcard ? MPI_ANY_SOURCE : 0;
+    int index = position == MATCH_HEAD ? 0 : position == MATCH_MIDDLE ? depth / 2 : depth - 1;
+    int *order = (int *)malloc(depth * sizeof(int));
+    int *slots = (int *)malloc(depth * sizeof(int)); // Buffer owned by each queue entry
+    MPI_Request *requests = (MPI_Request *)malloc(depth * sizeof(MPI_Request));
+    char *buffers = (char *)malloc((size_t)(depth + 1) * msg_size);
+    char *ping = buffers + (size_t)depth * msg_size;
+    char byte = 0;
+
+    memset(buffers, 0, (size_t)(depth + 1) * msg_size);
+    for (int k = 0; k < depth; k++)
+    {
+        order[k] = MATCH_TAG_BASE + k;
+        slots[k] = k;
+    }
+
+    // Fill the queue
+    if (unexpected)
+    {
+        if (rank == 0)
+        {
+            for (int k = 0; k < depth; k++)
+            {
+                MPI_Send(&byte, 1, MPI_BYTE, peer, order[k], MPI_COMM_WORLD);
+            }
+        }
+    }
+    else if (rank == 1)
+    {
+        for (int k = 0; k < depth; k++)
+        {
+            MPI_Irecv(buffers + (size_t)k * msg_size, msg_size, MPI_BYTE, source, order[k],
+                      MPI_COMM_WORLD, &requests[k]);
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    for (int i = -WARMUP_ITERATIONS; i < iterations; i++)
+    {
+        if (i == 0)
+        {
+            sync_start(rank);
+        }
+
+        int tag = unexpected ? 0 : order[index];
+        double t_start = get_time_us();
+        if (rank == 0)
+        {
+            MPI_Send(ping, msg_size, MPI_BYTE, peer, tag, MPI_COMM_WORLD);
+            MPI_Recv(ping, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        else if (unexpected)
+        {
+            MPI_Recv(ping, msg_size, MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        else
+        {
+            // Complete the matched receive and repost it at the tail
+            MPI_Request matched = requests[index];
+            int slot = slots[index];
+            MPI_Wait(&matched, MPI_STATUS_IGNORE);
+            memmove(&requests[index], &requests[index + 1],
+                    (depth - index - 1) * sizeof(MPI_Request));
+            memmove(&slots[index], &slots[index + 1], (depth - index - 1) * sizeof(int));
+            slots[depth - 1] = slot;
+            MPI_Irecv(buffers + (size_t)slot * msg_size, msg_size, MPI_BYTE, source, tag,
+                      MPI_COMM_WORLD, &requests[depth - 1]);
+        }
+        if (rank == 1)
+        {
+            MPI_Send(ping, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+        }
+        if (rank == 0 && i >= 0)
+        {
+            rtt[i] = get_time_us() - t_start;
+        }
+
+        if (!unexpected)
+        {
+            memmove(&order[index], &order[index + 1], (depth - index - 1) * sizeof(int));
+            order[depth - 1] = tag;
+        }
+    }
+
+    // Drain the queue
+    if (unexpected)
+    {
+        if (rank == 1)
+        {
+            for (int k = 0; k < depth; k++)
+            {
+                MPI_Recv(&byte, 1, MPI_BYTE, 0, order[k], MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            }
+        }
+    }
+    else if (rank == 1)
+    {
+        for (int k = 0; k < depth; k++)
+        {
+            MPI_Cancel(&requests[k]);
+            MPI_Wait(&requests[k], MPI_STATUS_IGNORE);
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    free(order);
+    free(slots);
+    free(requests);
+    free(buffers);
+}
+
+// Latency versus matching-queue depth, position and wildcard use
+static int run_match(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_match.csv");
+    int max_depth = (int)opt_long(argc, argv, "max-depth", MATCH_MAX_DEPTH);
+    int msg_size = (int)opt_long(argc, argv, "size", 8);
+    int iterations = (int)opt_long(argc, argv, "iterations", NUM_ITERATIONS);
+    const char *position_names[NUM_MATCH_POSITIONS] = {"head", "middle", "tail"};
+
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+    if (msg_size < 1)
+    {
+        msg_size = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, msg_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double *rtt = (double *)malloc(iterations * sizeof(double));
+
+    // Baseline: plain ping-pong with empty queues
+    Stats base;
+    pingpong_samples(rank, msg_size, send_buffer, recv_buffer, iterations, rtt);
+    if (rank == 0)
+    {
+        compute_stats(rtt, iterations, &base);
+    }
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "queue,wildcard,depth,position,median_rtt_us,p99_rtt_us,extra_us\n");
+        fprintf(outfile, "none,0,0,-,%.3f,%.3f,0.000\n", base.median, base.p99);
+        printf("Matching Queue Depth (%d-byte messages, %d iterations)\n\n", msg_size, iterations);
+        printf("Baseline RTT: %.2f us (empty queues)\n\n", base.median);
+        printf("%10s %9s %8s %8s %12s %12s %12s\n", "Queue", "Wildcard", "Depth", "Position",
+               "RTT (us)", "p99 (us)", "Extra (us)");
+        printf("---------- --------- -------- -------- ------------ ------------ ------------\n");
+    }
+
+    for (int unexpected = 0; unexpected < 2; unexpected++)
+    {
+        for (int wildcard = 0; wildcard < 2; wildcard++)
+        {
+            for (int depth = 1; depth <= max_depth; depth *= 4)
+            {
+                for (int position = 0; position < NUM_MATCH_POSITIONS; position++)
+                {
+                    // The ping always lands behind the unexpected queue
+                    if (unexpected && position != MATCH_TAIL)
+                    {
+                        continue;
+                    }
+
+                    match_pingpong(rank, depth, position, wildcard, unexpected, msg_size,
+                                   iterations, rtt);
+                    if (rank == 0)
+                    {
+                        Stats stats;
+                        compute_stats(rtt, iterations, &stats);
+                        const char *queue = unexpected ? "unexpected" : "posted";
+                        printf("%10s %9s %8d %8s %12.2f %12.2f %12.2f\n", queue,
+                               wildcard ? "any_src" : "-", depth, position_names[position],
+                               stats.median, stats.p99, stats.median - base.median);
+                        fprintf(outfile, "%s,%d,%d,%s,%.3f,%.3f,%.3f\n", queue, wildcard,
+                                depth, position_names[position], stats.median, stats.p99,
+                                stats.median - base.median);
+                    }
+                }
+            }
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(rtt);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Ping-pong where rank 1 is held back by delay_us after the ping has arrived.
+// Without early_post rank 1 only probes for the ping, so it sits in the
+// unexpected queue for the whole delay and is copied out of the library's
+// intermediate buffer when the receive is finally posted. With early_post the
+// receive is posted first and completes before the delay (expected path).
+// Either way the delay lies wholly on the critical path, so it is subtracted
+// from every RTT recorded on rank 0 with the --timer backend.
+static void delayed_pingpong(int rank, int msg_size, char *send_buffer, char *recv_buffer,
+                             double delay_us, int early_post, int iterations, double *rtt)
+{
+    int peer = 1 - rank;
+
+    for (int i = -WARMUP_ITERATIONS; i < iterations; i++)
+    {
+        if (i == 0)
+        {
+            sync_start(rank);
+        }
+
+        if (rank == 0)
+        {
+            uint64_t t_start = timer_read();
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            uint64_t t_end = timer_read();
+            if (i >= 0)
+            {
+                rtt[i] = ticks_to_us(t_end - t_start) - delay_us;
+            }
+        }
+        else if (early_post)
+        {
+            MPI_Request request;
+            int done = 0;
+            MPI_Irecv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &request);
+            while (!done)
+            {
+                MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+            }
+            spin_us(delay_us);
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+        }
+        else
+        {
+            int arrived = 0;
+            while (!arrived)
+            {
+                MPI_Iprobe(peer, 0, MPI_COMM_WORLD, &arrived, MPI_STATUS_IGNORE);
+            }
+            spin_us(delay_us);
+            MPI_Recv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Send(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+        }
+    }
+}
+
+// Expected versus unexpected receive path across the size sweep
+static int run_unexpected(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_unexpected.csv");
+    double delay_us = opt_double(argc, argv, "delay", UNEXPECTED_DELAY_US);
+    int iterations = (int)opt_long(argc, argv, "iterations", NUM_ITERATIONS);
+    int max_size = (int)opt_long(argc, argv, "max-size", MAX_MSG_SIZE);
+
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double *rtt = (double *)malloc(iterations * sizeof(double));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,expected_rtt_us,unexpected_rtt_us,extra_us,"
+                         "expected_bw_mbps,unexpected_bw_mbps,bw_loss_pct\n");
+        printf("Unexpected-Message Path (%d iterations, receiver delay %.1f us)\n\n",
+               iterations, delay_us);
+        printf("%10s %12s %12s %12s %12s %12s %8s\n", "Size (B)", "Expected", "Unexpected",
+               "Extra (us)", "Exp BW", "Unexp BW", "Loss %");
+        printf("---------- ------------ ------------ ------------ ------------ ------------ "
+               "--------\n");
+    }
+
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+    {
+        double median[2] = {0.0, 0.0};
+        for (int early_post = 1; early_post >= 0; early_post--)
+        {
+            delayed_pingpong(rank, msg_size, send_buffer, recv_buffer, delay_us, early_post,
+                             iterations, rtt);
+            if (rank == 0)
+            {
+                Stats stats;
+                compute_stats(rtt, iterations, &stats);
+                median[early_post] = stats.median;
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+
+        if (rank == 0)
+        {
+            double expected = median[1], unexpected = median[0];
+            double bw_expected = expected > 0 ? 2.0 * msg_size / expected : 0.0;
+            double bw_unexpected = unexpected > 0 ? 2.0 * msg_size / unexpected : 0.0;
+            double loss = bw_expected > 0 ? 100.0 * (1.0 - bw_unexpected / bw_expected) : 0.0;
+
+            printf("%10d %12.2f %12.2f %12.2f %12.2f %12.2f %8.1f\n", msg_size, expected,
+                   unexpected, unexpected - expected, bw_expected, bw_unexpected, loss);
+            fprintf(outfile, "%d,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f\n", msg_size, expected,
+                    unexpected, unexpected - expected, bw_expected, bw_unexpected, loss);
+        }
+    }
+
+    if (rank == 0)
+    {
+        fprintf(outfile, "\n# Receiver delay: %.1f us (subtracted from RTT)\n", delay_us);
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(rtt);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// One ping-pong stream on its own duplicated communicator
+typedef struct
+{
+    MPI_Comm comm;
+    int rank;
+    int msg_size;
+    int iterations;
+    char *send_buffer;
+    char *recv_buffer;
+    double *rtt; // Per round trip, rank 0 only
+    pthread_barrier_t *start; // Threaded mode: released when the clock starts
+    pthread_barrier_t *done;  // Threaded mode: reached when the stream finishes
+} Stream;
+
+// Blocking ping-pong on one stream; the body of each thread in threaded mode
+static void *stream_thread(void *arg)
+{
+    Stream *st = (Stream *)arg;
+    int peer = 1 - st->rank;
+
+    pthread_barrier_wait(st->start);
+
+    for (int i = 0; i < st->iterations; i++)
+    {
+        if (st->rank == 0)
+        {
+            double t_start = get_time_us();
+            MPI_Send(st->send_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm);
+            MPI_Recv(st->recv_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm,
+                     MPI_STATUS_IGNORE);
+            st->rtt[i] = get_time_us() - t_start;
+        }
+        else
+        {
+            MPI_Recv(st->recv_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm,
+                     MPI_STATUS_IGNORE);
+            MPI_Send(st->send_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm);
+        }
+    }
+    pthread_barrier_wait(st->done);
+    return NULL;
+}
+
+// All streams driven from one thread: every stream keeps one round trip in
+// flight and MPI_Waitany services whichever completes next
+static void run_streams_single(Stream *streams, int count)
+{
+    int rank = streams[0].rank;
+    int peer = 1 - rank;
+    MPI_Request *requests = (MPI_Request *)malloc(count * sizeof(MPI_Request));
+    int *done = (int *)calloc(count, sizeof(int));
+    double *t_start = (double *)malloc(count * sizeof(double));
+    int active = count;
+
+    for (int s = 0; s < count; s++)
+    {
+        Stream *st = &streams[s];
+        MPI_Irecv(st->recv_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm, &requests[s]);
+        if (rank == 0)
+        {
+            t_start[s] = get_time_us();
+            MPI_Send(st->send_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm);
+        }
+    }
+
+    while (active > 0)
+    {
+        int s;
+        MPI_Waitany(count, requests, &s, MPI_STATUS_IGNORE);
+        Stream *st = &streams[s];
+
+        if (rank == 0)
+        {
+            st->rtt[done[s]] = get_time_us() - t_start[s];
+        }
+        else
+        {
+            MPI_Send(st->send_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm);
+        }
+
+        if (++done[s] == st->iterations)
+        {
+            active--;
+            continue; // requests[s] is now MPI_REQUEST_NULL
+        }
+
+        MPI_Irecv(st->recv_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm, &requests[s]);
+        if (rank == 0)
+        {
+            t_start[s] = get_time_us();
+            MPI_Send(st->send_buffer, st->msg_size, MPI_BYTE, peer, 0, st->comm);
+        }
+    }
+
+    free(requests);
+    free(done);
+    free(t_start);
+}
+
+// Concurrent ping-pong streams on C duplicated communicators between the same
+// two ranks. Aggregate throughput that stops growing with C points at a lock
+// or a single endpoint shared by all communicators.
+static int run_multicomm(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_multicomm.csv");
+    int max_streams = (int)opt_long(argc, argv, "max-streams", MAX_STREAMS);
+    int msg_size = (int)opt_long(argc, argv, "size", 8);
+    int iterations = (int)opt_long(argc, argv, "iterations", STREAM_ITERATIONS);
+    int threaded = (int)opt_long(argc, argv, "threads", 0);
+
+    if (threaded && thread_provided < MPI_THREAD_MULTIPLE)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: --threads=1 requires --thread-level=multiple.\n");
+        }
+        return 1;
+    }
+    if (max_streams < 1)
+    {
+        max_streams = 1;
+    }
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+    if (msg_size < 1)
+    {
+        msg_size = 1;
+    }
+
+    Stream *streams = (Stream *)calloc(max_streams, sizeof(Stream));
+    pthread_t *threads = (pthread_t *)malloc(max_streams * sizeof(pthread_t));
+    double *all_rtt = (double *)malloc((size_t)max_streams * iterations * sizeof(double));
+    for (int s = 0; s < max_streams; s++)
+    {
+        Stream *st = &streams[s];
+        MPI_Comm_dup(MPI_COMM_WORLD, &st->comm);
+        st->rank = rank;
+        st->msg_size = msg_size;
+        st->rtt = &all_rtt[(size_t)s * iterations];
+        if (!alloc_buffers(rank, msg_size, &st->send_buffer, &st->recv_buffer))
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "streams,threaded,median_rtt_us,p99_rtt_us,msgs_per_sec,"
+                         "aggregate_mbps,speedup\n");
+        printf("Concurrent Streams on Duplicated Communicators (%d-byte messages, %s)\n\n",
+               msg_size, threaded ? "one thread per stream" : "single thread");
+        printf("%8s %12s %12s %14s %12s %8s\n", "Streams", "RTT (us)", "p99 (us)",
+               "Msgs/s", "Agg (MB/s)", "Speedup");
+        printf("-------- ------------ ------------ -------------- ------------ --------\n");
+    }
+
+    double base_rate = 0.0;
+    for (int count = 1; count <= max_streams; count *= 2)
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            // First pass warms up the communicators, second is timed
+            int rounds = pass ? iterations : WARMUP_ITERATIONS;
+            for (int s = 0; s < count; s++)
+            {
+                streams[s].iterations = rounds;
+            }
+
+            // Threads are created before the clock starts and held at the
+            // start barrier; the clock stops once all of them reach the done
+            // barrier, and they are joined after that
+            pthread_barrier_t start, done;
+            if (threaded)
+            {
+                pthread_barrier_init(&start, NULL, count + 1);
+                pthread_barrier_init(&done, NULL, count + 1);
+                for (int s = 0; s < count; s++)
+                {
+                    streams[s].start = &start;
+                    streams[s].done = &done;
+                    pthread_create(&threads[s], NULL, stream_thread, &streams[s]);
+                }
+            }
+
+            sync_start(rank);
+            double t_start = get_time_us();
+            if (threaded)
+            {
+                pthread_barrier_wait(&start);
+                pthread_barrier_wait(&done);
+            }
+            else
+            {
+                run_streams_single(streams, count);
+            }
+            double elapsed = get_time_us() - t_start;
+
+            if (threaded)
+            {
+                for (int s = 0; s < count; s++)
+                {
+                    pthread_join(threads[s], NULL);
+                }
+                pthread_barrier_destroy(&start);
+                pthread_barrier_destroy(&done);
+            }
+
+            if (rank == 0 && pass == 1)
+            {
+                // Two messages per round trip
+                double rate = elapsed > 0 ? 2.0 * count * iterations / (elapsed / 1e6) : 0.0;
+                double mbps = rate * msg_size / 1e6;
+                if (count == 1)
+                {
+                    base_rate = rate;
+                }
+
+                Stats stats;
+                compute_stats(all_rtt, count * iterations, &stats);
+                double speedup = base_rate > 0 ? rate / base_rate : 0.0;
+                printf("%8d %12.2f %12.2f %14.0f %12.2f %8.2f\n", count, stats.median,
+                       stats.p99, rate, mbps, speedup);
+                fprintf(outfile, "%d,%d,%.3f,%.3f,%.0f,%.3f,%.3f\n", count, threaded,
+                        stats.median, stats.p99, rate, mbps, speedup);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    for (int s = 0; s < max_streams; s++)
+    {
+        MPI_Comm_free(&streams[s].comm);
+        free(streams[s].send_buffer);
+        free(streams[s].recv_buffer);
+    }
+    free(streams);
+    free(threads);
+    free(all_rtt);
+    return 0;
+}
+
+// Harness self-test: the timed kernels with no-op communication. The time
+// per iteration is everything the harness adds to a real round trip; minus
+// the two timer reads it leaves the harness's own cost (stores and loop
+// control), which is what the target applies to.
+static int run_overhead(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_overhead.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", OVERHEAD_ITERATIONS);
+
+    if (rank != 0)
+    {
+        return 0;
+    }
+    if (iterations < 1)
+    {
+        iterations = 1;
+    }
+
+    FILE *outfile = open_output(out_path);
+    uint64_t *t = (uint64_t *)malloc((2 * (size_t)iterations + 1) * sizeof(uint64_t));
+    if (!outfile || !t)
+    {
+        free(t);
+        return 1;
+    }
+
+    fprintf(outfile, "timer,per_iteration_ns,timer_read_ns,harness_ns,resolution_ns,"
+                     "within_target\n");
+    printf("Harness Overhead (%d no-op iterations, target %.0f ns)\n\n",
+           iterations, OVERHEAD_TARGET_NS);
+    printf("%8s %14s %14s %14s %16s %8s\n", "Timer", "Per iter (ns)", "Read (ns)",
+           "Harness (ns)", "Resolution (ns)", "Target");
+    printf("-------- -------------- -------------- -------------- ---------------- --------\n");
+
+    int saved_backend = timer_backend;
+    for (int timer = 0; timer < NUM_TIMERS; timer++)
+    {
+        timer_backend = timer;
+        run_kernel(0, COMM_NOOP, 0, NULL, NULL, iterations, t);
+
+        double per_iter_ns = ticks_to_us(t[2 * (size_t)iterations] - t[0]) * 1000.0 / iterations;
+        double read_ns = read_costs[timer](iterations / 8 + 1) * timer_us_per_tick[timer] * 1000.0;
+        double harness_ns = per_iter_ns - 2.0 * read_ns;
+        if (harness_ns < 0)
+        {
+            harness_ns = 0.0; // Stores overlap the reads; the difference is noise
+        }
+        double resolution_ns = timer_tick_us(timer) * 1000.0;
+        int ok = harness_ns < OVERHEAD_TARGET_NS;
+
+        printf("%8s %14.2f %14.2f %14.2f %16.2f %8s\n", timer_names[timer], per_iter_ns,
+               read_ns, harness_ns, resolution_ns, ok ? "ok" : "over");
+        fprintf(outfile, "%s,%.3f,%.3f,%.3f,%.3f,%d\n", timer_names[timer], per_iter_ns,
+                read_ns, harness_ns, resolution_ns, ok);
+    }
+    timer_backend = saved_backend;
+
+    fclose(outfile);
+    printf("\nSaved to %s\n", out_path);
+    free(t);
+    return 0;
+}
+
+// Ping-pong timed in blocks of B round trips per sample, with B chosen so a
+// block spans at least BATCH_MIN_TICKS ticks of the active timer. Keeps many
+// blocks per size so the distribution survives, and reports both per-block
+// and implied per-message statistics.
+static int run_batch(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_batch.csv");
+    int samples = (int)opt_long(argc, argv, "samples", BATCH_SAMPLES);
+    int min_ticks = (int)opt_long(argc, argv, "min-ticks", BATCH_MIN_TICKS);
+    int max_size = (int)opt_long(argc, argv, "max-size", MAX_MSG_SIZE);
+
+    if (samples < 1)
+    {
+        samples = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+
+    uint64_t *t = (uint64_t *)malloc(((size_t)samples + 1) * sizeof(uint64_t));
+    double *block = (double *)malloc(samples * sizeof(double));
+    double tick_us = timer_tick_us(timer_backend);
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,batch,block_median_us,block_min_us,block_p99_us,"
+                         "msg_median_us,msg_min_us,msg_p99_us,msg_mean_us\n");
+        printf("Batched Ping-Pong (%d blocks per size, >= %d ticks of %.3g us, %s timer)\n\n",
+               samples, min_ticks, tick_us, timer_names[timer_backend]);
+        printf("%10s %8s %14s %12s %12s %12s\n", "Size (B)", "Batch", "Block (us)",
+               "RTT (us)", "RTT min", "RTT p99");
+        printf("---------- -------- -------------- ------------ ------------ ------------\n");
+    }
+
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+    {
+        KernelArgs args = {send_buffer, recv_buffer, msg_size, 1 - rank, MPI_COMM_WORLD,
+                           1, 1};
+        Kernel kernel = (rank == 0) ? ping_batch_kernels[timer_backend]
+                                    : pong_batch_kernels[timer_backend];
+
+        // Warmup block (not timed)
+        args.batch = WARMUP_ITERATIONS;
+        kernel(&args, t);
+
+        // Grow the block until a single one spans enough ticks
+        int batch = 1;
+        while (1)
+        {
+            args.batch = batch;
+            kernel(&args, t);
+
+            int next = 0;
+            if (rank == 0)
+            {
+                double span = ticks_to_us(t[1] - t[0]);
+                double needed = min_ticks * tick_us;
+                if (span < needed)
+                {
+                    next = (span > 0) ? (int)ceil(batch * 1.1 * needed / span) : batch * 2;
+                    next = (next > batch) ? next : batch + 1;
+                }
+            }
+            MPI_Bcast(&next, 1, MPI_INT, 0, MPI_COMM_WORLD);
+            if (next == 0)
+            {
+                break;
+            }
+            batch = next;
+        }
+
+        args.iterations = samples;
+        sync_start(rank);
+        kernel(&args, t);
+
+        if (rank == 0)
+        {
+            for (int i = 0; i < samples; i++)
+            {
+                block[i] = ticks_to_us(t[i + 1] - t[i]);
+            }
+
+            Stats stats;
+            compute_stats(block, samples, &stats);
+            printf("%10d %8d %14.2f %12.4f %12.4f %12.4f\n", msg_size, batch, stats.median,
+                   stats.median / batch, stats.min / batch, stats.p99 / batch);
+            fprintf(outfile, "%d,%d,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.4f\n", msg_size, batch,
+                    stats.median, stats.min, stats.p99, stats.median / batch,
+                    stats.min / batch, stats.p99 / batch, stats.mean / batch);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (rank == 0)
+    {
+        fprintf(outfile, "\n# Timer: %s, tick %.4g us\n", timer_names[timer_backend],
+                tick_us);
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(t);
+    free(block);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Background bulk stream from rank 0 to rank 1 on its own communicator
+typedef struct
+{
+    MPI_Comm comm;
+    int rank;
+    int bulk_size;
+    char *buffer;
+    double gap_us;     // Pause between bulk sends; sets the load level
+    volatile int stop; // Set by the main thread on rank 0
+    double bytes;      // Bulk bytes sent (rank 0)
+} LoadStream;
+
+static void *load_thread(void *arg)
+{
+    LoadStream *ls = (LoadStream *)arg;
+    MPI_Status status;
+
+    if (ls->rank == 0)
+    {
+        while (!ls->stop)
+        {
+            MPI_Send(ls->buffer, ls->bulk_size, MPI_BYTE, 1, 0, ls->comm);
+            ls->bytes += ls->bulk_size;
+            pause_us(ls->gap_us);
+        }
+        MPI_Send(ls->buffer, 0, MPI_BYTE, 1, LOAD_STOP_TAG, ls->comm);
+    }
+    else
+    {
+        do
+        {
+            MPI_Recv(ls->buffer, ls->bulk_size, MPI_BYTE, 0, MPI_ANY_TAG, ls->comm, &status);
+        } while (status.MPI_TAG != LOAD_STOP_TAG);
+    }
+    return NULL;
+}
+
+// Small-message latency while a background thread on each rank streams bulk
+// transfers over a separate communicator. The load level is the fraction of
+// the stream's unthrottled rate, set by pausing between bulk sends.
+static int run_load(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_load.csv");
+    int msg_size = (int)opt_long(argc, argv, "size", 8);
+    int bulk_size = (int)opt_long(argc, argv, "bulk-size", LOAD_BULK_SIZE);
+    int probes = (int)opt_long(argc, argv, "probes", LOAD_PROBES);
+    int levels[MAX_LIST];
+    int num_levels = parse_int_list(opt_str(argc, argv, "levels", LOAD_LEVELS), levels, MAX_LIST);
+
+    if (thread_provided < MPI_THREAD_MULTIPLE)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: load mode requires --thread-level=multiple.\n");
+        }
+        return 1;
+    }
+    if (probes < 1)
+    {
+        probes = 1;
+    }
+    if (msg_size < 1)
+    {
+        msg_size = 1;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, msg_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double *rtt = (double *)malloc(probes * sizeof(double));
+
+    LoadStream ls;
+    memset(&ls, 0, sizeof(ls));
+    MPI_Comm_dup(MPI_COMM_WORLD, &ls.comm);
+    ls.rank = rank;
+    ls.bulk_size = bulk_size;
+    ls.buffer = (char *)calloc(bulk_size > 0 ? bulk_size : 1, 1);
+
+    // Unthrottled per-message time of the bulk stream, no probes running
+    double full_rate_us = 0.0;
+    int full_count = 50;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_start = get_time_us();
+    for (int i = 0; i < full_count; i++)
+    {
+        if (rank == 0)
+        {
+            MPI_Send(ls.buffer, bulk_size, MPI_BYTE, 1, 0, ls.comm);
+        }
+        else
+        {
+            MPI_Recv(ls.buffer, bulk_size, MPI_BYTE, 0, 0, ls.comm, MPI_STATUS_IGNORE);
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    full_rate_us = (get_time_us() - t_start) / full_count;
+    MPI_Bcast(&full_rate_us, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "load_pct,bulk_mbps,p50_us,p90_us,p99_us,p999_us,max_us\n");
+        printf("Latency Under Load (%d-byte probes, %d-byte background stream)\n\n",
+               msg_size, bulk_size);
+        printf("Unloaded stream: %.1f us per bulk message (%.1f MB/s)\n\n", full_rate_us,
+               full_rate_us > 0 ? bulk_size / full_rate_us : 0.0);
+        printf("%6s %12s %10s %10s %10s %10s %10s\n", "Load %", "Bulk (MB/s)", "p50 (us)",
+               "p90 (us)", "p99 (us)", "p99.9 (us)", "Max (us)");
+        printf("------ ------------ ---------- ---------- ---------- ---------- ----------\n");
+    }
+
+    for (int l = 0; l < num_levels; l++)
+    {
+        int level = levels[l];
+        pthread_t thread;
+
+        ls.stop = 0;
+        ls.bytes = 0.0;
+        ls.gap_us = level > 0 ? full_rate_us * (100.0 - level) / level : 0.0;
+        if (level > 0)
+        {
+            pthread_create(&thread, NULL, load_thread, &ls);
+        }
+
+        double t_level = get_time_us();
+        pingpong_samples(rank, msg_size, send_buffer, recv_buffer, probes, rtt);
+        double elapsed = get_time_us() - t_level;
+
+        if (level > 0)
+        {
+            ls.stop = 1;
+            pthread_join(thread, NULL);
+        }
+
+        if (rank == 0)
+        {
+            Stats stats;
+            compute_stats(rtt, probes, &stats);
+            double bulk_mbps = elapsed > 0 ? ls.bytes / elapsed : 0.0;
+            double p90 = percentile(rtt, probes, 0.90);
+            double p999 = percentile(rtt, probes, 0.999);
+
+            printf("%6d %12.1f %10.2f %10.2f %10.2f %10.2f %10.2f\n", level, bulk_mbps,
+                   stats.median, p90, stats.p99, p999, stats.max);
+            fprintf(outfile, "%d,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f\n", level, bulk_mbps,
+                    stats.median, p90, stats.p99, p999, stats.max);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (rank == 0)
+    {
+        fprintf(outfile, "\n# Unloaded bulk stream: %.2f us per %d-byte message\n",
+                full_rate_us, bulk_size);
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    MPI_Comm_free(&ls.comm);
+    free(ls.buffer);
+    free(rtt);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Open-loop load generator. Rank 0 sends each request at its scheduled time
+// (constant or Poisson arrivals) whether or not earlier replies are back;
+// rank 1 echoes every request. Latency runs from the intended send time, so
+// a stalled sender still charges the delay to the requests it held back
+// (coordinated omission corrected). The monotonic clock keeps the schedule
+// immune to wall-clock adjustments.
+static int run_openloop(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_openloop.csv");
+    int msg_size = (int)opt_long(argc, argv, "size", 8);
+    int requests = (int)opt_long(argc, argv, "requests", OPEN_REQUESTS);
+    double knee_factor = opt_double(argc, argv, "knee-factor", OPEN_KNEE_FACTOR);
+    int poisson = strcmp(opt_str(argc, argv, "arrivals", "constant"), "poisson") == 0;
+    unsigned long long state = (unsigned long long)opt_long(argc, argv, "seed", DEFAULT_SEED);
+    int rates[MAX_LIST];
+    int num_rates = parse_int_list(opt_str(argc, argv, "rates", OPEN_RATES), rates, MAX_LIST);
+
+    if (msg_size < (int)sizeof(int))
+    {
+        msg_size = sizeof(int); // Requests carry their sequence number
+    }
+    if (requests < 1)
+    {
+        requests = 1;
+    }
+    if (state == 0)
+    {
+        state = DEFAULT_SEED;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, msg_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double warm[1];
+    pingpong_samples(rank, msg_size, send_buffer, recv_buffer, 1, warm);
+
+    // Rank 0 state: one payload slot and request per outstanding send
+    char *slots = (char *)calloc((size_t)requests, msg_size);
+    MPI_Request *send_requests = (MPI_Request *)malloc(requests * sizeof(MPI_Request));
+    double *intended = (double *)malloc(requests * sizeof(double));
+    double *actual = (double *)malloc(requests * sizeof(double));
+    double *latency = (double *)malloc(requests * sizeof(double));
+    double *service = (double *)malloc(requests * sizeof(double));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "offered_rate,achieved_rate,p50_us,p90_us,p99_us,max_us,"
+                         "service_p50_us,service_p99_us\n");
+        printf("Open-Loop Latency (%d-byte requests, %d per rate, %s arrivals)\n\n",
+               msg_size, requests, poisson ? "Poisson" : "constant");
+        printf("%10s %10s %10s %10s %10s %10s %12s\n", "Offered/s", "Achieved/s", "p50 (us)",
+               "p90 (us)", "p99 (us)", "Max (us)", "Svc p99 (us)");
+        printf("---------- ---------- ---------- ---------- ---------- ---------- ------------\n");
+    }
+
+    double base_p99 = 0.0;
+    int knee_rate = 0;
+    for (int r = 0; r < num_rates; r++)
+    {
+        double rate = rates[r] > 0 ? rates[r] : 1;
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        if (rank == 1)
+        {
+            // Echo server
+            for (int i = 0; i < requests; i++)
+            {
+                MPI_Recv(recv_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                MPI_Send(recv_buffer, msg_size, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+            }
+        }
+        else
+        {
+            // Schedule: constant spacing or exponential interarrival times
+            double start = timer_read_mono() / 1000.0 + 10.0;
+            double t = start;
+            for (int i = 0; i < requests; i++)
+            {
+                intended[i] = t;
+                double u = (double)((next_random(&state) >> 11) + 1) / 9007199254740993.0;
+                t += poisson ? -log(u) * 1e6 / rate : 1e6 / rate;
+            }
+
+            MPI_Request reply;
+            MPI_Irecv(recv_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &reply);
+            int sent = 0, received = 0;
+            double last_reply = start;
+            while (received < requests)
+            {
+                double now = timer_read_mono() / 1000.0;
+                if (sent < requests && now >= intended[sent])
+                {
+                    char *slot = slots + (size_t)sent * msg_size;
+                    memcpy(slot, &sent, sizeof(int));
+                    actual[sent] = now;
+                    MPI_Isend(slot, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &send_requests[sent]);
+                    sent++;
+                    continue;
+                }
+
+                int done = 0;
+                MPI_Test(&reply, &done, MPI_STATUS_IGNORE);
+                if (done)
+                {
+                    int seq;
+                    memcpy(&seq, recv_buffer, sizeof(int));
+                    last_reply = timer_read_mono() / 1000.0;
+                    latency[received] = last_reply - intended[seq];
+                    service[received] = last_reply - actual[seq];
+                    received++;
+                    if (received < requests)
+                    {
+                        MPI_Irecv(recv_buffer, msg_size, MPI_BYTE, 1, 0, MPI_COMM_WORLD, &reply);
+                    }
+                }
+            }
+            MPI_Waitall(requests, send_requests, MPI_STATUSES_IGNORE);
+
+            double achieved = requests / ((last_reply - start) / 1e6);
+            Stats stats, svc;
+            compute_stats(latency, requests, &stats);
+            compute_stats(service, requests, &svc);
+            double p90 = percentile(latency, requests, 0.90);
+
+            // Knee: tail latency blows up against the best p99 of the lower
+            // rates, or the server stops keeping up with the offered rate
+            if (r > 0 && !knee_rate &&
+                (stats.p99 > knee_factor * base_p99 || achieved < 0.95 * rate))
+            {
+                knee_rate = rates[r];
+            }
+            if (r == 0 || stats.p99 < base_p99)
+            {
+                base_p99 = stats.p99;
+            }
+
+            printf("%10d %10.0f %10.2f %10.2f %10.2f %10.2f %12.2f\n", rates[r], achieved,
+                   stats.median, p90, stats.p99, stats.max, svc.p99);
+            fprintf(outfile, "%d,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", rates[r], achieved,
+                    stats.median, p90, stats.p99, stats.max, svc.median, svc.p99);
+        }
+    }
+
+    if (rank == 0)
+    {
+        printf("\n--- Results ---\n");
+        if (knee_rate)
+        {
+            printf("Saturation knee: ~%d msgs/s offered\n", knee_rate);
+            fprintf(outfile, "\n# Saturation knee: %d msgs/s\n", knee_rate);
+        }
+        else
+        {
+            printf("Saturation knee: not reached\n");
+            fprintf(outfile, "\n# Saturation knee: not reached\n");
+        }
+        printf("\n");
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(slots);
+    free(send_requests);
+    free(intended);
+    free(actual);
+    free(latency);
+    free(service);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// One grid cell of the RPC emulation: rank 0 keeps depth requests in flight,
+// each slot tagged with its index; rank 1 answers every request with a
+// response of resp_size after think_us of busy work. Fills latency (rank 0,
+// requests entries) unless it is NULL, and returns the elapsed time of the
+// whole cell.
+static double rpc_cell(int rank, int req_size, int resp_size, int depth, double think_us,
+                       int requests, char *req_buffers, char *resp_buffers, double *latency)
+{
+    MPI_Status status;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t_start = get_time_us();
+
+    if (rank == 1)
+    {
+        for (int i = 0; i < requests; i++)
+        {
+            MPI_Recv(req_buffers, req_size, MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+            spin_us(think_us);
+            MPI_Send(resp_buffers, resp_size, MPI_BYTE, 0, status.MPI_TAG, MPI_COMM_WORLD);
+        }
+        return get_time_us() - t_start;
+    }
+
+    MPI_Request *recv_requests = (MPI_Request *)malloc(depth * sizeof(MPI_Request));
+    MPI_Request *send_requests = (MPI_Request *)malloc(depth * sizeof(MPI_Request));
+    double *issued = (double *)malloc(depth * sizeof(double));
+    int sent = 0, done = 0;
+
+    for (int slot = 0; slot < depth; slot++)
+    {
+        recv_requests[slot] = MPI_REQUEST_NULL;
+        send_requests[slot] = MPI_REQUEST_NULL;
+    }
+
+    // Fill the pipeline
+    for (int slot = 0; slot < depth && sent < requests; slot++, sent++)
+    {
+        MPI_Irecv(resp_buffers + (size_t)slot * resp_size, resp_size, MPI_BYTE, 1, slot,
+                  MPI_COMM_WORLD, &recv_requests[slot]);
+        issued[slot] = get_time_us();
+        MPI_Isend(req_buffers + (size_t)slot * req_size, req_size, MPI_BYTE, 1, slot,
+                  MPI_COMM_WORLD, &send_requests[slot]);
+    }
+
+    while (done < requests)
+    {
+        int slot;
+        MPI_Waitany(depth, recv_requests, &slot, MPI_STATUS_IGNORE);
+        if (latency)
+        {
+            latency[done] = get_time_us() - issued[slot];
+        }
+        done++;
+        MPI_Wait(&send_requests[slot], MPI_STATUS_IGNORE);
+
+        if (sent < requests)
+        {
+            MPI_Irecv(resp_buffers + (size_t)slot * resp_size, resp_size, MPI_BYTE, 1, slot,
+                      MPI_COMM_WORLD, &recv_requests[slot]);
+            issued[slot] = get_time_us();
+            MPI_Isend(req_buffers + (size_t)slot * req_size, req_size, MPI_BYTE, 1, slot,
+                      MPI_COMM_WORLD, &send_requests[slot]);
+            sent++;
+        }
+    }
+    double elapsed = get_time_us() - t_start;
+
+    free(recv_requests);
+    free(send_requests);
+    free(issued);
+    return elapsed;
+}
+
+// Request-response emulation over a (request size, response size) grid with
+// optional server think time and pipelining depth
+static int run_rpc(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_rpc.csv");
+    double think_us = opt_double(argc, argv, "think", 0.0);
+    int requests = (int)opt_long(argc, argv, "requests", RPC_REQUESTS);
+    int req_sizes[MAX_LIST], resp_sizes[MAX_LIST], depths[MAX_LIST];
+    int num_req = parse_int_list(opt_str(argc, argv, "req-sizes", RPC_REQ_SIZES), req_sizes,
+                                 MAX_LIST);
+    int num_resp = parse_int_list(opt_str(argc, argv, "resp-sizes", RPC_RESP_SIZES), resp_sizes,
+                                  MAX_LIST);
+    int num_depths = parse_int_list(opt_str(argc, argv, "depths", RPC_DEPTHS), depths, MAX_LIST);
+
+    if (requests < 1)
+    {
+        requests = 1;
+    }
+
+    int max_req = 1, max_resp = 1, max_depth = 1;
+    for (int i = 0; i < num_req; i++)
+    {
+        max_req = req_sizes[i] > max_req ? req_sizes[i] : max_req;
+    }
+    for (int i = 0; i < num_resp; i++)
+    {
+        max_resp = resp_sizes[i] > max_resp ? resp_sizes[i] : max_resp;
+    }
+    for (int i = 0; i < num_depths; i++)
+    {
+        depths[i] = depths[i] < 1 ? 1 : depths[i];
+        max_depth = depths[i] > max_depth ? depths[i] : max_depth;
+    }
+
+    // One request and response buffer per pipeline slot
+    char *req_buffers = (char *)calloc((size_t)max_depth, max_req);
+    char *resp_buffers = (char *)calloc((size_t)max_depth, max_resp);
+    double *latency = (double *)malloc(requests * sizeof(double));
+    double *grid_latency = (double *)malloc((size_t)num_req * num_resp * sizeof(double));
+    double *grid_rate = (double *)malloc((size_t)num_req * num_resp * sizeof(double));
+    if (!req_buffers || !resp_buffers)
+    {
+        fprintf(stderr, "Rank %d: Failed to allocate memory\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "req_bytes,resp_bytes,depth,think_us,median_us,p99_us,"
+                         "requests_per_sec,bandwidth_mbps\n");
+        printf("RPC Emulation (%d requests per cell, think time %.1f us)\n", requests, think_us);
+    }
+
+    for (int d = 0; d < num_depths; d++)
+    {
+        for (int q = 0; q < num_req; q++)
+        {
+            for (int p = 0; p < num_resp; p++)
+            {
+                // Warmup, then the measured cell
+                rpc_cell(rank, req_sizes[q], resp_sizes[p], depths[d], think_us,
+                         WARMUP_ITERATIONS, req_buffers, resp_buffers, NULL);
+                double elapsed = rpc_cell(rank, req_sizes[q], resp_sizes[p], depths[d], think_us,
+                                          requests, req_buffers, resp_buffers, latency);
+                if (rank == 0)
+                {
+                    Stats stats;
+                    compute_stats(latency, requests, &stats);
+                    double rate = elapsed > 0 ? requests / (elapsed / 1e6) : 0.0;
+                    double mbps = elapsed > 0 ? (double)requests *
+                                                    (req_sizes[q] + resp_sizes[p]) / elapsed
+                                              : 0.0;
+                    grid_latency[q * num_resp + p] = stats.median;
+                    grid_rate[q * num_resp + p] = rate;
+                    fprintf(outfile, "%d,%d,%d,%.1f,%.3f,%.3f,%.0f,%.2f\n", req_sizes[q],
+                            resp_sizes[p], depths[d], think_us, stats.median, stats.p99, rate,
+                            mbps);
+                }
+            }
+        }
+
+        // Print the grids for this depth: rows are request sizes, columns responses
+        if (rank == 0)
+        {
+            for (int table = 0; table < 2; table++)
+            {
+                const double *grid = table ? grid_rate : grid_latency;
+                printf("\nDepth %d: %s (rows: request bytes, columns: response bytes)\n",
+                       depths[d], table ? "requests/s" : "median latency (us)");
+                printf("%10s", "");
+                for (int p = 0; p < num_resp; p++)
+                {
+                    printf(" %12d", resp_sizes[p]);
+                }
+                printf("\n");
+                for (int q = 0; q < num_req; q++)
+                {
+                    printf("%10d", req_sizes[q]);
+                    for (int p = 0; p < num_resp; p++)
+                    {
+                        printf(table ? " %12.0f" : " %12.2f", grid[q * num_resp + p]);
+                    }
+                    printf("\n");
+                }
+            }
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("\nSaved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(req_buffers);
+    free(resp_buffers);
+    free(latency);
+    free(grid_latency);
+    free(grid_rate);
+    return 0;
+}
+
+// Windowed streaming from sender to receiver on comm: window messages in
+// flight, then a 1-byte ack. Returns the elapsed time on the sender.
+static double stream_windows(int sender, int peer, int msg_size, int window, int windows,
+                             char *buffer, MPI_Request *requests, MPI_Comm comm)
+{
+    char ack = 0;
+    double t_start = get_time_us();
+
+    for (int w = 0; w < windows; w++)
+    {
+        for (int i = 0; i < window; i++)
+        {
+            if (sender)
+            {
+                MPI_Isend(buffer + (size_t)i * msg_size, msg_size, MPI_BYTE, peer, 0, comm,
+                          &requests[i]);
+            }
+            else
+            {
+                MPI_Irecv(buffer + (size_t)i * msg_size, msg_size, MPI_BYTE, peer, 0, comm,
+                          &requests[i]);
+            }
+        }
+        MPI_Waitall(window, requests, MPI_STATUSES_IGNORE);
+
+        if (sender)
+        {
+            MPI_Recv(&ack, 1, MPI_BYTE, peer, 1, comm, MPI_STATUS_IGNORE);
+        }
+        else
+        {
+            MPI_Send(&ack, 1, MPI_BYTE, peer, 1, comm);
+        }
+    }
+    return get_time_us() - t_start;
+}
+
+// Multi-rail striping. Rank i streams to rank i + N/2, so launching with the
+// first half on one node and the second half on the other (and each pair
+// pinned to a NIC by the launcher, e.g. a per-rank UCX_NET_DEVICES) puts one
+// pair per rail. The binding is not done here: the device variables each
+// rank sees, including PINGPONG_RAIL, are only echoed as labels, so
+// PINGPONG_RAIL is a reporting tag that launcher-level NIC binding must
+// back up. For each size, 1..K pairs
+// stream at once; aggregate bandwidth against a single pair shows where
+// using more rails starts to pay off.
+static int run_rails(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_rails.csv");
+    int window = (int)opt_long(argc, argv, "window", STREAM_WINDOW);
+    int windows = (int)opt_long(argc, argv, "windows", STREAM_WINDOWS);
+    int max_size = (int)opt_long(argc, argv, "max-size", MAX_MSG_SIZE);
+    int pairs = num_procs / 2;
+
+    if (num_procs < 2 || num_procs % 2)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: rails mode requires an even number of processes.\n");
+        }
+        return 1;
+    }
+    window = window < 1 ? 1 : window;
+    windows = windows < 1 ? 1 : windows;
+
+    int pair = rank % pairs;
+    int sender = rank < pairs;
+    int peer = sender ? rank + pairs : rank - pairs;
+
+    // Device selection each rank was launched with
+    char device[128];
+    const char *env_names[] = {"PINGPONG_RAIL", "UCX_NET_DEVICES", "OMPI_MCA_btl_tcp_if_include",
+                               "OMPI_MCA_btl_openib_if_include", "MV2_IBA_HCA", "FI_PROVIDER"};
+    char host[64] = "";
+    gethostname(host, sizeof(host) - 1);
+    snprintf(device, sizeof(device), "%s", host);
+    for (size_t i = 0; i < sizeof(env_names) / sizeof(env_names[0]); i++)
+    {
+        const char *value = getenv(env_names[i]);
+        if (value)
+        {
+            size_t used = strlen(device);
+            snprintf(device + used, sizeof(device) - used, " %s=%s", env_names[i], value);
+        }
+    }
+    char *devices = NULL;
+    if (rank == 0)
+    {
+        devices = (char *)malloc((size_t)num_procs * sizeof(device));
+    }
+    MPI_Gather(device, sizeof(device), MPI_CHAR, devices, sizeof(device), MPI_CHAR, 0,
+               MPI_COMM_WORLD);
+
+    char *buffer = (char *)calloc((size_t)window, max_size);
+    MPI_Request *requests = (MPI_Request *)malloc(window * sizeof(MPI_Request));
+    double *elapsed_all = (double *)malloc(num_procs * sizeof(double));
+    double *aggregate = (double *)malloc((pairs + 1) * sizeof(double));
+    if (!buffer)
+    {
+        fprintf(stderr, "Rank %d: Failed to allocate memory\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,active_pairs,aggregate_mbps,per_pair_mbps,"
+                         "ratio_to_single\n");
+        printf("Multi-Rail Striping (%d pairs, window %d x %d)\n\n", pairs, window, windows);
+        for (int p = 0; p < pairs; p++)
+        {
+            printf("Pair %d: [%s] -> [%s]\n", p, devices + (size_t)p * sizeof(device),
+                   devices + (size_t)(p + pairs) * sizeof(device));
+        }
+        printf("\n%10s", "Size (B)");
+        for (int k = 1; k <= pairs; k++)
+        {
+            printf(" %9d pr", k);
+        }
+        printf(" %10s\n", "Gain");
+    }
+
+    int helps_at = 0;
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+    {
+        for (int k = 1; k <= pairs; k++)
+        {
+            int active = pair < k;
+
+            // Warmup, then all active pairs stream at once
+            MPI_Barrier(MPI_COMM_WORLD);
+            if (active)
+            {
+                stream_windows(sender, peer, msg_size, window, 1, buffer, requests,
+                               MPI_COMM_WORLD);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+            double elapsed = 0.0;
+            if (active)
+            {
+                elapsed = stream_windows(sender, peer, msg_size, window, windows, buffer,
+                                         requests, MPI_COMM_WORLD);
+            }
+            MPI_Gather(&elapsed, 1, MPI_DOUBLE, elapsed_all, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+            if (rank == 0)
+            {
+                // Aggregate over the slowest active sender
+                double slowest = 0.0;
+                for (int p = 0; p < k; p++)
+                {
+                    slowest = elapsed_all[p] > slowest ? elapsed_all[p] : slowest;
+                }
+                double bytes = (double)k * window * windows * msg_size;
+                aggregate[k] = slowest > 0 ? bytes / slowest : 0.0;
+                fprintf(outfile, "%d,%d,%.2f,%.2f,%.3f\n", msg_size, k, aggregate[k],
+                        aggregate[k] / k, aggregate[1] > 0 ? aggregate[k] / aggregate[1] : 0.0);
+            }
+        }
+
+        if (rank == 0)
+        {
+            double gain = aggregate[1] > 0 ? aggregate[pairs] / aggregate[1] : 0.0;
+            printf("%10d", msg_size);
+            for (int k = 1; k <= pairs; k++)
+            {
+                printf(" %12.1f", aggregate[k]);
+            }
+            printf(" %10.2f\n", gain);
+            // Start of the run of sizes, up to the largest, where more rails
+            // keep paying off (small sizes gain from message rate instead)
+            if (pairs > 1 && gain >= RAIL_GAIN)
+            {
+                helps_at = helps_at ? helps_at : msg_size;
+            }
+            else
+            {
+                helps_at = 0;
+            }
+        }
+    }
+
+    if (rank == 0)
+    {
+        printf("\n--- Results ---\n");
+        if (helps_at)
+        {
+            printf("Multiple rails help from %d bytes up (aggregate >= %.1fx one pair)\n",
+                   helps_at, RAIL_GAIN);
+            fprintf(outfile, "\n# Multiple rails help from: %d bytes\n", helps_at);
+        }
+        else
+        {
+            printf("Multiple rails never beat one pair by %.1fx\n", RAIL_GAIN);
+            fprintf(outfile, "\n# Multiple rails help from: never\n");
+        }
+        for (int r = 0; r < num_procs; r++)
+        {
+            fprintf(outfile, "# Rank %d device: %s\n", r, devices + (size_t)r * sizeof(device));
+        }
+        printf("\n");
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(devices);
+    free(buffer);
+    free(requests);
+    free(elapsed_all);
+    free(aggregate);
+    return 0;
+}
+
+// Move one message as a sequence of chunk-sized pieces with at most window
+// nonblocking operations in flight. Same tag and communicator, so MPI's
+// non-overtaking rule keeps the chunks in order.
+static void chunked_transfer(int sending, int peer, char *buffer, int msg_size, int chunk,
+                             int window, MPI_Request *requests)
+{
+    int chunks = (msg_size + chunk - 1) / chunk;
+
+    for (int c = 0; c < chunks; c++)
+    {
+        int slot = c % window;
+        if (c >= window)
+        {
+            MPI_Wait(&requests[slot], MPI_STATUS_IGNORE);
+        }
+
+        int offset = c * chunk;
+        int count = (msg_size - offset < chunk) ? msg_size - offset : chunk;
+        if (sending)
+        {
+            MPI_Isend(buffer + offset, count, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &requests[slot]);
+        }
+        else
+        {
+            MPI_Irecv(buffer + offset, count, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &requests[slot]);
+        }
+    }
+    MPI_Waitall(chunks < window ? chunks : window, requests, MPI_STATUSES_IGNORE);
+}
+
+// User-level segmentation of large messages: ping-pong where each direction
+// is split into chunks pipelined through a window of MPI_Isend/MPI_Irecv,
+// compared with the monolithic MPI_Send of the same size
+static int run_chunked(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_chunked.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", CHUNK_ITERATIONS);
+    int sizes[MAX_LIST], chunks[MAX_LIST], windows[MAX_LIST];
+    int num_sizes = parse_int_list(opt_str(argc, argv, "sizes", CHUNK_SIZES), sizes, MAX_LIST);
+    int num_chunks = parse_int_list(opt_str(argc, argv, "chunks", CHUNK_CHUNKS), chunks, MAX_LIST);
+    int num_windows = parse_int_list(opt_str(argc, argv, "windows", CHUNK_WINDOWS), windows,
+                                     MAX_LIST);
+    int peer = 1 - rank;
+
+    iterations = iterations < 1 ? 1 : iterations;
+    int max_size = 1, max_window = 1;
+    for (int i = 0; i < num_sizes; i++)
+    {
+        max_size = sizes[i] > max_size ? sizes[i] : max_size;
+    }
+    for (int i = 0; i < num_windows; i++)
+    {
+        windows[i] = windows[i] < 1 ? 1 : windows[i];
+        max_window = windows[i] > max_window ? windows[i] : max_window;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    MPI_Request *requests = (MPI_Request *)malloc(max_window * sizeof(MPI_Request));
+    double *rtt = (double *)malloc(iterations * sizeof(double));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,chunk_bytes,window,median_rtt_us,bandwidth_mbps,"
+                         "speedup\n");
+        printf("Chunked Large-Message Transfer (%d iterations)\n\n", iterations);
+        printf("%10s %10s %8s %12s %12s %8s\n", "Size (B)", "Chunk (B)", "Window", "RTT (us)",
+               "BW (MB/s)", "Speedup");
+        printf("---------- ---------- -------- ------------ ------------ --------\n");
+    }
+
+    for (int s = 0; s < num_sizes; s++)
+    {
+        int msg_size = sizes[s];
+
+        // Monolithic reference
+        pingpong_samples(rank, msg_size, send_buffer, recv_buffer, iterations, rtt);
+        double mono_bw = 0.0;
+        double best_bw = 0.0;
+        int best_chunk = 0, best_window = 0;
+        if (rank == 0)
+        {
+            Stats stats;
+            compute_stats(rtt, iterations, &stats);
+            mono_bw = stats.median > 0 ? 2.0 * msg_size / stats.median : 0.0;
+            printf("%10d %10s %8s %12.2f %12.2f %8.2f\n", msg_size, "mono", "-", stats.median,
+                   mono_bw, 1.0);
+            fprintf(outfile, "%d,0,0,%.3f,%.2f,1.000\n", msg_size, stats.median, mono_bw);
+        }
+
+        for (int c = 0; c < num_chunks; c++)
+        {
+            if (chunks[c] < 1 || chunks[c] >= msg_size)
+            {
+                continue;
+            }
+            for (int w = 0; w < num_windows; w++)
+            {
+                MPI_Barrier(MPI_COMM_WORLD);
+                for (int i = -WARMUP_ITERATIONS; i < iterations; i++)
+                {
+                    if (i == 0)
+                    {
+                        sync_start(rank);
+                    }
+                    double t_start = get_time_us();
+                    chunked_transfer(rank == 0, peer, rank == 0 ? send_buffer : recv_buffer,
+                                     msg_size, chunks[c], windows[w], requests);
+                    chunked_transfer(rank != 0, peer, rank == 0 ? recv_buffer : send_buffer,
+                                     msg_size, chunks[c], windows[w], requests);
+                    if (rank == 0 && i >= 0)
+                    {
+                        rtt[i] = get_time_us() - t_start;
+                    }
+                }
+
+                if (rank == 0)
+                {
+                    Stats stats;
+                    compute_stats(rtt, iterations, &stats);
+                    double bw = stats.median > 0 ? 2.0 * msg_size / stats.median : 0.0;
+                    double speedup = mono_bw > 0 ? bw / mono_bw : 0.0;
+                    printf("%10d %10d %8d %12.2f %12.2f %8.2f\n", msg_size, chunks[c],
+                           windows[w], stats.median, bw, speedup);
+                    fprintf(outfile, "%d,%d,%d,%.3f,%.2f,%.3f\n", msg_size, chunks[c],
+                            windows[w], stats.median, bw, speedup);
+                    if (bw > best_bw)
+                    {
+                        best_bw = bw;
+                        best_chunk = chunks[c];
+                        best_window = windows[w];
+                    }
+                }
+            }
+        }
+
+        if (rank == 0)
+        {
+            if (best_bw > mono_bw)
+            {
+                printf("  best: %d-byte chunks, window %d (%.2fx monolithic)\n\n", best_chunk,
+                       best_window, best_bw / mono_bw);
+                fprintf(outfile, "# Best for %d bytes: chunk %d window %d (%.3fx)\n", msg_size,
+                        best_chunk, best_window, best_bw / mono_bw);
+            }
+            else
+            {
+                printf("  best: monolithic send\n\n");
+                fprintf(outfile, "# Best for %d bytes: monolithic\n", msg_size);
+            }
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(requests);
+    free(rtt);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Map and touch an anonymous buffer the MPI library has never seen
+static char *map_buffer(int rank, size_t size)
+{
+    char *buffer = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        fprintf(stderr, "Rank %d: mmap of %zu bytes failed\n", rank, size);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    memset(buffer, 'A', size);
+    return buffer;
+}
+
+// One blocking round trip using the same buffer for both directions; returns
+// the elapsed time on rank 0
+static double roundtrip_once(int rank, char *buffer, int msg_size)
+{
+    int peer = 1 - rank;
+    double t_start = get_time_us();
+    if (rank == 0)
+    {
+        MPI_Send(buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+        MPI_Recv(buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        MPI_Recv(buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Send(buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD);
+    }
+    return get_time_us() - t_start;
+}
+
+// Memory registration cost: the same round trip from one reused buffer, from
+// a freshly mapped buffer every iteration, and from pools of W buffers cycled
+// round-robin to find where the working set outgrows the registration cache
+static int run_regcache(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_regcache.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", REG_ITERATIONS);
+    double gap_us = opt_double(argc, argv, "gap-us", 0.0);
+    long max_pool_bytes = opt_long(argc, argv, "max-pool-bytes", REG_MAX_POOL_BYTES);
+    int sizes[MAX_LIST], pools[MAX_LIST];
+    int num_sizes = parse_int_list(opt_str(argc, argv, "sizes", REG_SIZES), sizes, MAX_LIST);
+    int num_pools = parse_int_list(opt_str(argc, argv, "pools", REG_POOLS), pools, MAX_LIST);
+
+    iterations = iterations < 1 ? 1 : iterations;
+    double *rtt = (double *)malloc(iterations * sizeof(double));
+    double *unmap = (double *)malloc(iterations * sizeof(double));
+    double *bare_unmap = (double *)malloc(iterations * sizeof(double));
+    int max_pool = 1;
+    for (int i = 0; i < num_pools; i++)
+    {
+        max_pool = pools[i] > max_pool ? pools[i] : max_pool;
+    }
+    char **pool = (char **)malloc(max_pool * sizeof(char *));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,case,pool,median_rtt_us,p99_rtt_us,hit_rate\n");
+        printf("Memory Registration Cost (%d iterations, %.0f us gap)\n\n", iterations, gap_us);
+        printf("%10s %8s %6s %12s %12s %8s\n", "Size (B)", "Case", "Pool", "Median (us)",
+               "P99 (us)", "Hit");
+        printf("---------- -------- ------ ------------ ------------ --------\n");
+    }
+
+    for (int s = 0; s < num_sizes; s++)
+    {
+        int msg_size = sizes[s];
+        Stats reused = {0}, fresh = {0}, unmap_stats = {0}, bare_stats = {0};
+
+        // Reused buffer: registration paid once during warmup
+        char *buffer = map_buffer(rank, msg_size);
+        for (int i = 0; i < WARMUP_ITERATIONS; i++)
+        {
+            roundtrip_once(rank, buffer, msg_size);
+        }
+        sync_start(rank);
+        for (int i = 0; i < iterations; i++)
+        {
+            rtt[i] = roundtrip_once(rank, buffer, msg_size);
+            pause_us(gap_us);
+        }
+        munmap(buffer, msg_size);
+        compute_stats(rtt, iterations, &reused);
+
+        // Fresh mapping each iteration: every transfer pays registration and
+        // every munmap pays deregistration through the library's memory hooks.
+        // The bare munmap of a buffer MPI never saw is the baseline.
+        sync_start(rank);
+        for (int i = 0; i < iterations; i++)
+        {
+            buffer = map_buffer(rank, msg_size);
+            rtt[i] = roundtrip_once(rank, buffer, msg_size);
+            double t_start = get_time_us();
+            munmap(buffer, msg_size);
+            unmap[i] = get_time_us() - t_start;
+
+            buffer = map_buffer(rank, msg_size);
+            t_start = get_time_us();
+            munmap(buffer, msg_size);
+            bare_unmap[i] = get_time_us() - t_start;
+            pause_us(gap_us);
+        }
+        compute_stats(rtt, iterations, &fresh);
+        compute_stats(unmap, iterations, &unmap_stats);
+        compute_stats(bare_unmap, iterations, &bare_stats);
+
+        double reg_cost = fresh.median - reused.median;
+        if (rank == 0)
+        {
+            printf("%10d %8s %6s %12.2f %12.2f %8s\n", msg_size, "reused", "-", reused.median,
+                   reused.p99, "-");
+            printf("%10d %8s %6s %12.2f %12.2f %8s\n", msg_size, "fresh", "-", fresh.median,
+                   fresh.p99, "-");
+            fprintf(outfile, "%d,reused,0,%.3f,%.3f,\n", msg_size, reused.median, reused.p99);
+            fprintf(outfile, "%d,fresh,0,%.3f,%.3f,\n", msg_size, fresh.median, fresh.p99);
+        }
+
+        // Pools cycled round-robin; the first pass registers every buffer
+        int cliff = 0;
+        for (int p = 0; p < num_pools; p++)
+        {
+            int w = pools[p];
+            if (w < 1 || (long)w * msg_size > max_pool_bytes)
+            {
+                continue;
+            }
+            for (int b = 0; b < w; b++)
+            {
+                pool[b] = map_buffer(rank, msg_size);
+                roundtrip_once(rank, pool[b], msg_size);
+            }
+            sync_start(rank);
+            for (int i = 0; i < iterations; i++)
+            {
+                rtt[i] = roundtrip_once(rank, pool[i % w], msg_size);
+                pause_us(gap_us);
+            }
+            for (int b = 0; b < w; b++)
+            {
+                munmap(pool[b], msg_size);
+            }
+
+            if (rank == 0)
+            {
+                Stats stats;
+                compute_stats(rtt, iterations, &stats);
+                // Where the pool median sits between always-hit and always-miss
+                double hit = reg_cost > 0 ? (fresh.median - stats.median) / reg_cost : 1.0;
+                hit = hit < 0.0 ? 0.0 : (hit > 1.0 ? 1.0 : hit);
+                if (!cliff && hit < 0.5)
+                {
+                    cliff = w;
+                }
+                printf("%10d %8s %6d %12.2f %12.2f %8.2f\n", msg_size, "pool", w, stats.median,
+                       stats.p99, hit);
+                fprintf(outfile, "%d,pool,%d,%.3f,%.3f,%.3f\n", msg_size, w, stats.median,
+                        stats.p99, hit);
+            }
+        }
+
+        if (rank == 0)
+        {
+            double dereg_cost = unmap_stats.median - bare_stats.median;
+            printf("  registration %.2f us, deregistration %.2f us (munmap %.2f vs bare %.2f)",
+                   reg_cost, dereg_cost, unmap_stats.median, bare_stats.median);
+            if (cliff)
+            {
+                printf(", cache cliff at %d buffers (%ld bytes)\n\n", cliff,
+                       (long)cliff * msg_size);
+            }
+            else
+            {
+                printf(", no cache cliff within tested pools\n\n");
+            }
+            fprintf(outfile,
+                    "# Size %d: registration_us=%.3f deregistration_us=%.3f cliff_pool=%d\n",
+                    msg_size, reg_cost, dereg_cost, cliff);
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(pool);
+    free(rtt);
+    free(unmap);
+    free(bare_unmap);
+    return 0;
+}
+
+// Memory the MPI library allocates per connected peer, per outstanding
+// request and for large transfers, from RSS sampled around each step.
+// RSS is page-granular and the allocator may reuse freed memory, so small
+// deltas are noise; the per-peer figure sharpens as N grows.
+static int run_footprint(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_footprint.csv");
+    long large_size = opt_long(argc, argv, "large-size", FOOT_LARGE_SIZE);
+    int requests[MAX_LIST];
+    int num_requests = parse_int_list(opt_str(argc, argv, "requests", FOOT_REQUESTS), requests,
+                                      MAX_LIST);
+
+    if (num_procs < 2)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: footprint mode requires at least 2 processes.\n");
+        }
+        return 1;
+    }
+    if (rss_bytes() < 0)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: footprint mode needs /proc/self/statm.\n");
+        }
+        return 1;
+    }
+
+    // Checkpoints after 1, 2, 4, ... rounds of the pair schedule, each round
+    // being a first contact with one new peer. Slot 0 is the baseline.
+    int rounds = pair_rounds(num_procs);
+    int checkpoints = 1;
+    while ((1 << (checkpoints - 1)) < rounds)
+    {
+        checkpoints++;
+    }
+    checkpoints++;
+    double *rss = (double *)malloc(checkpoints * sizeof(double));
+    double *peers = (double *)malloc(checkpoints * sizeof(double));
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    rss[0] = rss_bytes();
+    peers[0] = 0;
+    int contacted = 0, next = 1;
+    for (int round = 0; round < rounds; round++)
+    {
+        int partner = pair_partner(rank, num_procs, round);
+        if (partner >= 0)
+        {
+            contact_peer(rank, partner, 6);
+            contacted++;
+        }
+        if (round + 1 == (1 << (next - 1)) || round + 1 == rounds)
+        {
+            rss[next] = rss_bytes();
+            peers[next] = contacted;
+            next++;
+        }
+    }
+    checkpoints = next;
+
+    double *all_rss = NULL, *all_peers = NULL;
+    if (rank == 0)
+    {
+        all_rss = (double *)malloc((size_t)num_procs * checkpoints * sizeof(double));
+        all_peers = (double *)malloc((size_t)num_procs * checkpoints * sizeof(double));
+    }
+    MPI_Gather(rss, checkpoints, MPI_DOUBLE, all_rss, checkpoints, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+    MPI_Gather(peers, checkpoints, MPI_DOUBLE, all_peers, checkpoints, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+
+    // Outstanding receives between ranks 0 and 1: rank 0 posts K receives,
+    // samples RSS, then rank 1 satisfies them. Buffers and the request array
+    // are allocated before the first sample.
+    double *request_delta = (double *)calloc(num_requests > 0 ? num_requests : 1, sizeof(double));
+    for (int k = 0; k < num_requests; k++)
+    {
+        int count = requests[k] < 1 ? 1 : requests[k];
+        char *bytes = (char *)calloc(count, 1);
+        MPI_Request *reqs = (MPI_Request *)malloc(count * sizeof(MPI_Request));
+        for (int i = 0; i < count; i++)
+        {
+            reqs[i] = MPI_REQUEST_NULL;
+        }
+
+        if (rank == 0)
+        {
+            double before = rss_bytes();
+            for (int i = 0; i < count; i++)
+            {
+                MPI_Irecv(&bytes[i], 1, MPI_BYTE, 1, 7, MPI_COMM_WORLD, &reqs[i]);
+            }
+            request_delta[k] = rss_bytes() - before;
+            MPI_Send(NULL, 0, MPI_BYTE, 1, 8, MPI_COMM_WORLD);
+            MPI_Waitall(count, reqs, MPI_STATUSES_IGNORE);
+        }
+        else if (rank == 1)
+        {
+            MPI_Recv(NULL, 0, MPI_BYTE, 0, 8, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            for (int i = 0; i < count; i++)
+            {
+                MPI_Send(&bytes[i], 1, MPI_BYTE, 0, 7, MPI_COMM_WORLD);
+            }
+        }
+        free(reqs);
+        free(bytes);
+    }
+
+    // Large transfers between ranks 0 and 1, after the buffers are touched
+    double large_delta[2] = {0.0, 0.0};
+    if (rank < 2)
+    {
+        char *send_buffer, *recv_buffer;
+        if (!alloc_buffers(rank, large_size, &send_buffer, &recv_buffer))
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        double before = rss_bytes();
+        MPI_Sendrecv(send_buffer, (int)large_size, MPI_BYTE, 1 - rank, 9, recv_buffer,
+                     (int)large_size, MPI_BYTE, 1 - rank, 9, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        large_delta[rank] = rss_bytes() - before;
+        free(send_buffer);
+        free(recv_buffer);
+    }
+    if (rank == 1)
+    {
+        MPI_Send(&large_delta[1], 1, MPI_DOUBLE, 0, 10, MPI_COMM_WORLD);
+    }
+    else if (rank == 0)
+    {
+        MPI_Recv(&large_delta[1], 1, MPI_DOUBLE, 1, 10, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+
+    int status = 0;
+    if (rank == 0)
+    {
+        FILE *outfile = open_output(out_path);
+        if (outfile)
+        {
+            double *growth = (double *)malloc(num_procs * sizeof(double));
+            double *per_peer = (double *)malloc(num_procs * sizeof(double));
+            double last_per_peer = 0.0;
+
+            fprintf(outfile, "phase,count,median_delta_bytes,max_delta_bytes,"
+                             "bytes_per_unit\n");
+            printf("Memory Footprint (%d ranks)\n\n", num_procs);
+            printf("%-10s %8s %14s %14s %14s\n", "Phase", "Count", "Median (B)", "Max (B)",
+                   "Per unit (B)");
+            printf("---------- -------- -------------- -------------- --------------\n");
+            for (int c = 1; c < checkpoints; c++)
+            {
+                for (int r = 0; r < num_procs; r++)
+                {
+                    double delta = all_rss[(size_t)r * checkpoints + c] -
+                                   all_rss[(size_t)r * checkpoints];
+                    double n = all_peers[(size_t)r * checkpoints + c];
+                    growth[r] = delta;
+                    per_peer[r] = n > 0 ? delta / n : 0.0;
+                }
+                Stats growth_stats, peer_stats;
+                compute_stats(growth, num_procs, &growth_stats);
+                compute_stats(per_peer, num_procs, &peer_stats);
+                int count = 0;
+                for (int r = 0; r < num_procs; r++)
+                {
+                    int n = (int)all_peers[(size_t)r * checkpoints + c];
+                    count = n > count ? n : count;
+                }
+                last_per_peer = peer_stats.median;
+                printf("%-10s %8d %14.0f %14.0f %14.0f\n", "peers", count, growth_stats.median,
+                       growth_stats.max, peer_stats.median);
+                fprintf(outfile, "peers,%d,%.0f,%.0f,%.1f\n", count, growth_stats.median,
+                        growth_stats.max, peer_stats.median);
+            }
+            for (int k = 0; k < num_requests; k++)
+            {
+                int count = requests[k] < 1 ? 1 : requests[k];
+                printf("%-10s %8d %14.0f %14s %14.1f\n", "requests", count, request_delta[k], "-",
+                       request_delta[k] / count);
+                fprintf(outfile, "requests,%d,%.0f,,%.1f\n", count, request_delta[k],
+                        request_delta[k] / count);
+            }
+            double large_max = large_delta[0] > large_delta[1] ? large_delta[0] : large_delta[1];
+            printf("%-10s %8ld %14.0f %14.0f %14s\n", "large", large_size,
+                   (large_delta[0] + large_delta[1]) / 2.0, large_max, "-");
+            fprintf(outfile, "large,%ld,%.0f,%.0f,\n", large_size,
+                    (large_delta[0] + large_delta[1]) / 2.0, large_max);
+
+            printf("\n--- Results ---\n");
+            printf("Library memory per connected peer: %.0f bytes (median rank)\n", last_per_peer);
+            printf("\n");
+            fprintf(outfile, "\n# Bytes per peer: %.1f\n", last_per_peer);
+            fprintf(outfile, "# Page size: %ld\n", sysconf(_SC_PAGESIZE));
+            fclose(outfile);
+            printf("Saved to %s\n", out_path);
+
+            free(growth);
+            free(per_peer);
+        }
+        else
+        {
+            status = 1;
+        }
+    }
+
+    // Cleanup
+    free(rss);
+    free(peers);
+    free(all_rss);
+    free(all_peers);
+    free(request_delta);
+    return status;
+}
+
+// Warmup of one size timed round trip by round trip on rank 0; returns the
+// total and stores the first round trip
+static double timed_warmup(int rank, char *buffer, int msg_size, double *first)
+{
+    double total = 0.0;
+    for (int i = 0; i < WARMUP_ITERATIONS; i++)
+    {
+        double rtt = roundtrip_once(rank, buffer, msg_size);
+        if (i == 0)
+        {
+            *first = rtt;
+        }
+        total += rtt;
+    }
+    return total;
+}
+
+// How much the old per-size output path perturbed the next measurement:
+// rank 0 writes a row to stdout and the CSV and flushes both (what live
+// output does between sizes), then both ranks pass the barrier and run the
+// next warmup. Compared against the same warmup with no I/O in between.
+static int run_iostall(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_iostall.csv");
+    const char *scratch_path = opt_str(argc, argv, "scratch", "iostall_scratch.csv");
+    int repeats = (int)opt_long(argc, argv, "repeats", IOSTALL_REPEATS);
+    int sizes[MAX_LIST];
+    int num_sizes = parse_int_list(opt_str(argc, argv, "sizes", IOSTALL_SIZES), sizes,
+                                   MAX_LIST);
+
+    repeats = repeats < 1 ? 1 : repeats;
+    int max_size = 1;
+    for (int i = 0; i < num_sizes; i++)
+    {
+        max_size = sizes[i] > max_size ? sizes[i] : max_size;
+    }
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double *quiet = (double *)malloc(repeats * sizeof(double));
+    double *noisy = (double *)malloc(repeats * sizeof(double));
+    double *quiet_first = (double *)malloc(repeats * sizeof(double));
+    double *noisy_first = (double *)malloc(repeats * sizeof(double));
+    double *io_time = (double *)malloc(repeats * sizeof(double));
+    double *barrier_wait = (double *)malloc(repeats * sizeof(double));
+
+    // The scratch file stands in for a live CSV; this mode's own results go
+    // through the buffered path
+    FILE *outfile = NULL, *scratch = NULL;
+    if (rank == 0)
+    {
+        scratch = fopen(scratch_path, "w");
+        if (!scratch)
+        {
+            fprintf(stderr, "Error: Could not open scratch file %s\n", scratch_path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    Stats results[MAX_LIST][6];
+    for (int s = 0; s < num_sizes; s++)
+    {
+        int msg_size = sizes[s];
+        timed_warmup(rank, send_buffer, msg_size, &quiet_first[0]);
+
+        for (int k = 0; k < repeats; k++)
+        {
+            // Quiet: barrier straight into the warmup
+            MPI_Barrier(MPI_COMM_WORLD);
+            quiet[k] = timed_warmup(rank, send_buffer, msg_size, &quiet_first[k]);
+
+            // Old path: format, write and flush a row before the barrier
+            io_time[k] = 0.0;
+            if (rank == 0)
+            {
+                double t_start = get_time_us();
+                fprintf(stdout, "  probe %10d %12.2f %12.2f\n", msg_size, quiet[k],
+                        quiet_first[k]);
+                fflush(stdout);
+                fprintf(scratch, "%d,%.3f,%.3f\n", msg_size, quiet[k], quiet_first[k]);
+                fflush(scratch);
+                io_time[k] = get_time_us() - t_start;
+            }
+            double t_barrier = get_time_us();
+            MPI_Barrier(MPI_COMM_WORLD);
+            barrier_wait[k] = get_time_us() - t_barrier;
+            noisy[k] = timed_warmup(rank, send_buffer, msg_size, &noisy_first[k]);
+        }
+
+        // Rank 1 sees the stall as time spent in the barrier
+        if (rank == 1)
+        {
+            MPI_Send(barrier_wait, repeats, MPI_DOUBLE, 0, 11, MPI_COMM_WORLD);
+        }
+        else if (rank == 0)
+        {
+            MPI_Recv(barrier_wait, repeats, MPI_DOUBLE, 1, 11, MPI_COMM_WORLD,
+                     MPI_STATUS_IGNORE);
+            compute_stats(quiet, repeats, &results[s][0]);
+            compute_stats(noisy, repeats, &results[s][1]);
+            compute_stats(quiet_first, repeats, &results[s][2]);
+            compute_stats(noisy_first, repeats, &results[s][3]);
+            compute_stats(io_time, repeats, &results[s][4]);
+            compute_stats(barrier_wait, repeats, &results[s][5]);
+        }
+    }
+
+    if (rank == 0)
+    {
+        fclose(scratch);
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "msg_size_bytes,io_median_us,io_max_us,peer_wait_median_us,"
+                         "warmup_quiet_us,warmup_after_io_us,first_quiet_us,"
+                         "first_after_io_us,perturbation_us\n");
+        printf("\nStdio Perturbation of the Next Warmup (%d repeats, %d warmup round trips)\n\n",
+               repeats, WARMUP_ITERATIONS);
+        printf("%10s %10s %10s %10s %12s %12s %12s %12s\n", "Size (B)", "I/O (us)",
+               "I/O max", "Peer wait", "Warm quiet", "Warm after", "First quiet",
+               "First after");
+        printf("---------- ---------- ---------- ---------- ------------ ------------ "
+               "------------ ------------\n");
+        double worst = 0.0;
+        for (int s = 0; s < num_sizes; s++)
+        {
+            Stats *r = results[s];
+            double perturbation = r[1].median - r[0].median;
+            worst = perturbation > worst ? perturbation : worst;
+            printf("%10d %10.2f %10.2f %10.2f %12.2f %12.2f %12.2f %12.2f\n", sizes[s],
+                   r[4].median, r[4].max, r[5].median, r[0].median, r[1].median, r[2].median,
+                   r[3].median);
+            fprintf(outfile, "%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", sizes[s],
+                    r[4].median, r[4].max, r[5].median, r[0].median, r[1].median, r[2].median,
+                    r[3].median, perturbation);
+        }
+
+        printf("\n--- Results ---\n");
+        printf("Largest warmup perturbation from live output: %.2f us\n", worst);
+        printf("\n");
+        fprintf(outfile, "\n# Largest warmup perturbation: %.3f us\n", worst);
+        fprintf(outfile, "# Scratch file: %s\n", scratch_path);
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(quiet);
+    free(noisy);
+    free(quiet_first);
+    free(noisy_first);
+    free(io_time);
+    free(barrier_wait);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// One runtime-writable integer MPI_T control variable
+typedef struct
+{
+    char name[64];
+    MPI_Datatype datatype;
+    MPI_T_cvar_handle handle;
+    long long original;
+} Cvar;
+
+static long long cvar_read(const Cvar *cv)
+{
+    union
+    {
+        int i;
+        unsigned u;
+        unsigned long ul;
+        unsigned long long ull;
+        MPI_Count c;
+    } value;
+    memset(&value, 0, sizeof(value));
+    MPI_T_cvar_read(cv->handle, &value);
+    if (cv->datatype == MPI_INT)
+    {
+        return value.i;
+    }
+    if (cv->datatype == MPI_UNSIGNED)
+    {
+        return value.u;
+    }
+    if (cv->datatype == MPI_UNSIGNED_LONG)
+    {
+        return (long long)value.ul;
+    }
+    if (cv->datatype == MPI_UNSIGNED_LONG_LONG)
+    {
+        return (long long)value.ull;
+    }
+    return value.c;
+}
+
+static int cvar_write(const Cvar *cv, long long setting)
+{
+    union
+    {
+        int i;
+        unsigned u;
+        unsigned long ul;
+        unsigned long long ull;
+        MPI_Count c;
+    } value;
+    if (cv->datatype == MPI_INT)
+    {
+        value.i = (int)setting;
+    }
+    else if (cv->datatype == MPI_UNSIGNED)
+    {
+        value.u = (unsigned)setting;
+    }
+    else if (cv->datatype == MPI_UNSIGNED_LONG)
+    {
+        value.ul = (unsigned long)setting;
+    }
+    else if (cv->datatype == MPI_UNSIGNED_LONG_LONG)
+    {
+        value.ull = (unsigned long long)setting;
+    }
+    else
+    {
+        value.c = (MPI_Count)setting;
+    }
+    return MPI_T_cvar_write(cv->handle, &value) == MPI_SUCCESS;
+}
+
+// Find integer control variables writable after MPI_Init whose lower-cased
+// name contains one of the comma-separated substrings (exact names work too)
+static int cvar_select(const char *selection, Cvar *cvars, int max_cvars)
+{
+    int count = 0, num_cvars = 0;
+    MPI_T_cvar_get_num(&num_cvars);
+
+    static MPI_Comm world = MPI_COMM_WORLD; // Object handle for communicator-bound cvars
+    for (int i = 0; i < num_cvars && count < max_cvars; i++)
+    {
+        Cvar *cv = &cvars[count];
+        int name_len = sizeof(cv->name), desc_len = 0;
+        int verbosity, bind, scope;
+        MPI_T_enum enumtype;
+        if (MPI_T_cvar_get_info(i, cv->name, &name_len, &verbosity, &cv->datatype, &enumtype,
+                                NULL, &desc_len, &bind, &scope) != MPI_SUCCESS)
+        {
+            continue;
+        }
+        if (scope == MPI_T_SCOPE_CONSTANT || scope == MPI_T_SCOPE_READONLY)
+        {
+            continue;
+        }
+        if (bind != MPI_T_BIND_NO_OBJECT && bind != MPI_T_BIND_MPI_COMM)
+        {
+            continue;
+        }
+        if (cv->datatype != MPI_INT && cv->datatype != MPI_UNSIGNED &&
+            cv->datatype != MPI_UNSIGNED_LONG && cv->datatype != MPI_UNSIGNED_LONG_LONG &&
+            cv->datatype != MPI_COUNT)
+        {
+            continue;
+        }
+
+        char lower[64], list[256];
+        for (int c = 0; c < (int)sizeof(lower); c++)
+        {
+            lower[c] = (char)tolower((unsigned char)cv->name[c]);
+        }
+        snprintf(list, sizeof(list), "%s", selection);
+        int selected = 0;
+        for (char *token = strtok(list, ","); token; token = strtok(NULL, ","))
+        {
+            selected |= strstr(lower, token) != NULL || strcmp(cv->name, token) == 0;
+        }
+
+        int element_count;
+        if (!selected || MPI_T_cvar_handle_alloc(i, bind == MPI_T_BIND_MPI_COMM ? &world : NULL,
+                                                 &cv->handle, &element_count) != MPI_SUCCESS)
+        {
+            continue;
+        }
+        if (element_count != 1)
+        {
+            MPI_T_cvar_handle_free(&cv->handle);
+            continue;
+        }
+        cv->original = cvar_read(cv);
+        count++;
+    }
+    return count;
+}
+
+// Sweep runtime-writable MPI_T control variables (eager limit, rendezvous
+// threshold, pipeline chunk) one at a time over a set of values, rerunning
+// the size range for each, then report the best setting per size band and
+// write it as a tuning file. Default values are the variable's own setting
+// scaled by 1/4..4. Each variable is restored before the next one is swept.
+// A library may accept a write yet only honour the variable at MPI_Init;
+// identical rows across values are the sign of that.
+static int run_cvars(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_cvars.csv");
+    const char *tuning_path = opt_str(argc, argv, "tuning", CVAR_TUNING_FILE);
+    int sizes[MAX_LIST], values_arg[MAX_LIST];
+    int num_sizes = parse_int_list(opt_str(argc, argv, "sizes", CVAR_SIZES), sizes, MAX_LIST);
+    int num_values_arg = parse_int_list(opt_str(argc, argv, "values", ""), values_arg, MAX_LIST);
+
+    int provided;
+    if (MPI_T_init_thread(MPI_THREAD_SINGLE, &provided) != MPI_SUCCESS)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: MPI_T_init_thread failed.\n");
+        }
+        return 1;
+    }
+
+    Cvar cvars[MAX_CVARS];
+    int num_cvars = cvar_select(opt_str(argc, argv, "cvars", CVAR_DEFAULT), cvars, MAX_CVARS);
+    if (num_cvars == 0)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: no runtime-writable control variable matches --cvars; "
+                            "tune this library through its environment instead.\n");
+        }
+        MPI_T_finalize();
+        return 1;
+    }
+
+    int max_size = 1;
+    for (int i = 0; i < num_sizes; i++)
+    {
+        max_size = sizes[i] > max_size ? sizes[i] : max_size;
+    }
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        MPI_T_finalize();
+        return 1;
+    }
+
+    calibrate_harness(rank);
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "cvar,value,msg_size_bytes,rtt_us,bandwidth_mbps\n");
+        printf("MPI_T Control Variable Sweep (%d variables, %d sizes)\n\n", num_cvars,
+               num_sizes);
+        printf("%-40s %10s %10s %12s %12s\n", "Variable", "Value", "Size (B)", "RTT (us)",
+               "BW (MB/s)");
+        printf("---------------------------------------- ---------- ---------- ------------ "
+               "------------\n");
+    }
+
+    // Best (lowest RTT) setting seen for each size, across all variables
+    double best_rtt[MAX_LIST];
+    int best_cvar[MAX_LIST];
+    long long best_value[MAX_LIST];
+    for (int s = 0; s < num_sizes; s++)
+    {
+        best_rtt[s] = 1e30;
+        best_cvar[s] = -1;
+        best_value[s] = 0;
+    }
+
+    for (int v = 0; v < num_cvars; v++)
+    {
+        Cvar *cv = &cvars[v];
+        long long values[MAX_LIST];
+        int num_values = 0;
+        if (num_values_arg > 0)
+        {
+            for (int i = 0; i < num_values_arg; i++)
+            {
+                values[num_values++] = values_arg[i];
+            }
+        }
+        else
+        {
+            long long base = cv->original > 0 ? cv->original : 4096;
+            values[num_values++] = base / 4;
+            values[num_values++] = base / 2;
+            values[num_values++] = base;
+            values[num_values++] = base * 2;
+            values[num_values++] = base * 4;
+        }
+
+        for (int k = 0; k < num_values; k++)
+        {
+            // Every rank must accept the write or the setting is skipped
+            int ok = cvar_write(cv, values[k]), all_ok;
+            MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+            if (!all_ok)
+            {
+                if (rank == 0)
+                {
+                    printf("%-40s %10lld  (write rejected)\n", cv->name, values[k]);
+                }
+                continue;
+            }
+
+            for (int s = 0; s < num_sizes; s++)
+            {
+                SizeResult result;
+                measure_size(rank, sizes[s], send_buffer, recv_buffer, &result);
+                MPI_Barrier(MPI_COMM_WORLD);
+                if (rank == 0)
+                {
+                    printf("%-40s %10lld %10d %12.2f %12.2f\n", cv->name, values[k], sizes[s],
+                           result.avg_rtt, result.bandwidth_mbps);
+                    fprintf(outfile, "%s,%lld,%d,%.3f,%.2f\n", cv->name, values[k], sizes[s],
+                            result.avg_rtt, result.bandwidth_mbps);
+                    if (result.avg_rtt < best_rtt[s])
+                    {
+                        best_rtt[s] = result.avg_rtt;
+                        best_cvar[s] = v;
+                        best_value[s] = values[k];
+                    }
+                }
+            }
+        }
+        cvar_write(cv, cv->original);
+    }
+
+    // Consecutive sizes with the same winner form one band
+    if (rank == 0)
+    {
+        FILE *tuning = fopen(tuning_path, "w");
+        if (!tuning)
+        {
+            fprintf(stderr, "Error: Could not open tuning file %s\n", tuning_path);
+        }
+        else
+        {
+            fprintf(tuning, "# MPI_T control variable tuning (lowest RTT per size band)\n");
+            fprintf(tuning, "# size_lo size_hi variable=value mean_rtt_us\n");
+        }
+        printf("\n--- Results ---\n");
+        int start = 0;
+        for (int s = 1; s <= num_sizes; s++)
+        {
+            if (s < num_sizes && best_cvar[s] == best_cvar[start] &&
+                best_value[s] == best_value[start])
+            {
+                continue;
+            }
+            if (best_cvar[start] >= 0)
+            {
+                const char *name = cvars[best_cvar[start]].name;
+                printf("%d-%d bytes: %s=%lld\n", sizes[start], sizes[s - 1], name,
+                       best_value[start]);
+                fprintf(outfile, "# Band %d-%d: %s=%lld\n", sizes[start], sizes[s - 1], name,
+                        best_value[start]);
+                if (tuning)
+                {
+                    double mean_rtt = 0.0;
+                    for (int b = start; b < s; b++)
+                    {
+                        mean_rtt += best_rtt[b];
+                    }
+                    fprintf(tuning, "%d %d %s=%lld %.3f\n", sizes[start], sizes[s - 1], name,
+                            best_value[start], mean_rtt / (s - start));
+                }
+            }
+            start = s;
+        }
+        printf("\n");
+        if (tuning)
+        {
+            fclose(tuning);
+            printf("Tuning written to %s\n", tuning_path);
+        }
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    for (int v = 0; v < num_cvars; v++)
+    {
+        MPI_T_cvar_handle_free(&cvars[v].handle);
+    }
+    MPI_T_finalize();
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Ways of swapping a buffer's worth of data with the peer
+enum
+{
+    EXCHANGE_ISEND,    // MPI_Irecv + MPI_Isend + MPI_Waitall, separate buffers
+    EXCHANGE_SENDRECV, // MPI_Sendrecv, separate buffers
+    EXCHANGE_REPLACE,  // MPI_Sendrecv_replace, one buffer
+    NUM_EXCHANGES
+};
+
+static const char *exchange_names[NUM_EXCHANGES] = {"isend", "sendrecv", "replace"};
+
+static void exchange_once(int method, int peer, char *send_buffer, char *recv_buffer,
+                          int msg_size)
+{
+    if (method == EXCHANGE_ISEND)
+    {
+        MPI_Request requests[2];
+        MPI_Irecv(recv_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &requests[0]);
+        MPI_Isend(send_buffer, msg_size, MPI_BYTE, peer, 0, MPI_COMM_WORLD, &requests[1]);
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    }
+    else if (method == EXCHANGE_SENDRECV)
+    {
+        MPI_Sendrecv(send_buffer, msg_size, MPI_BYTE, peer, 0, recv_buffer, msg_size, MPI_BYTE,
+                     peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    else
+    {
+        MPI_Sendrecv_replace(send_buffer, msg_size, MPI_BYTE, peer, 0, peer, 0, MPI_COMM_WORLD,
+                             MPI_STATUS_IGNORE);
+    }
+}
+
+// In-place versus separate-buffer exchange: both ranks swap msg_size bytes
+// at once. Each method runs its own pass over the sizes. VmHWM is reset and
+// the RSS recorded at the start of the pass, so the peak growth after each
+// size captures transient library buffers such as the temporary copy
+// MPI_Sendrecv_replace may make; the allocator keeps freed memory resident,
+// so the figure is cumulative over the pass and the heap is trimmed between
+// methods. An untimed pass of every method over every size runs first, so
+// the library's one-time allocations do not land on whichever method is
+// measured first. The maximum over both ranks is reported. User buffers are
+// allocated once and listed separately.
+static int run_exchange(int argc, char *argv[], int rank, int num_procs)
+{
+    (void)num_procs;
+    const char *out_path = opt_str(argc, argv, "out", "results_exchange.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", EXCHANGE_ITERATIONS);
+    int max_size = (int)opt_long(argc, argv, "max-size", MAX_MSG_SIZE);
+    int peer = 1 - rank;
+
+    iterations = iterations < 1 ? 1 : iterations;
+    int peak_resettable = reset_peak_rss() && peak_rss_bytes() >= 0;
+
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    double *samples = (double *)malloc(iterations * sizeof(double));
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "method,msg_size_bytes,median_us,p99_us,bandwidth_mbps,"
+                         "peak_extra_bytes,user_buffer_bytes\n");
+        printf("Exchange: Sendrecv vs Sendrecv_replace vs Isend/Irecv (%d iterations)\n\n",
+               iterations);
+        if (!peak_resettable)
+        {
+            printf("Note: /proc/self/clear_refs unavailable; peak memory is cumulative\n\n");
+        }
+        printf("%-9s %10s %12s %12s %12s %14s\n", "Method", "Size (B)", "Median (us)",
+               "P99 (us)", "BW (MB/s)", "Peak+ (B)");
+        printf("--------- ---------- ------------ ------------ ------------ --------------\n");
+    }
+
+    // Priming pass (not measured), including the sync and reduction the
+    // measured passes use, whose first calls allocate inside the library
+    for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+    {
+        double prime = 0.0, prime_max;
+        sync_start(rank);
+        for (int method = 0; method < NUM_EXCHANGES; method++)
+        {
+            exchange_once(method, peer, send_buffer, recv_buffer, msg_size);
+        }
+        MPI_Reduce(&prime, &prime_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
+
+    // Peak growth over the whole pass and largest-size bandwidth per method
+    double worst_peak[NUM_EXCHANGES] = {0.0};
+    double bw_at_max[NUM_EXCHANGES] = {0.0};
+    for (int method = 0; method < NUM_EXCHANGES; method++)
+    {
+#if defined(__GLIBC__)
+        malloc_trim(0);
+#endif
+        MPI_Barrier(MPI_COMM_WORLD);
+        Stats stats[32];
+        double max_peak[32];
+        int count = 0;
+        reset_peak_rss();
+        double rss_before = rss_bytes();
+
+        for (int msg_size = MIN_MSG_SIZE; msg_size <= max_size; msg_size *= 2)
+        {
+            for (int i = 0; i < WARMUP_ITERATIONS; i++)
+            {
+                exchange_once(method, peer, send_buffer, recv_buffer, msg_size);
+            }
+
+            sync_start(rank);
+            for (int i = 0; i < iterations; i++)
+            {
+                double t_start = get_time_us();
+                exchange_once(method, peer, send_buffer, recv_buffer, msg_size);
+                samples[i] = get_time_us() - t_start;
+            }
+            double peak = peak_rss_bytes() - rss_before;
+            peak = peak < 0 ? 0 : peak;
+            MPI_Reduce(&peak, &max_peak[count], 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            compute_stats(samples, iterations, &stats[count]);
+            count++;
+        }
+
+        // Output after the pass: filling the output buffers grows RSS too
+        for (int k = 0, msg_size = MIN_MSG_SIZE; rank == 0 && k < count; k++, msg_size *= 2)
+        {
+            // Each exchange moves msg_size bytes in each direction
+            double bw = stats[k].median > 0 ? 2.0 * msg_size / stats[k].median : 0.0;
+            long user_bytes = (method == EXCHANGE_REPLACE ? 1L : 2L) * msg_size;
+            printf("%-9s %10d %12.2f %12.2f %12.2f %14.0f\n", exchange_names[method], msg_size,
+                   stats[k].median, stats[k].p99, bw, max_peak[k]);
+            fprintf(outfile, "%s,%d,%.3f,%.3f,%.2f,%.0f,%ld\n", exchange_names[method],
+                    msg_size, stats[k].median, stats[k].p99, bw, max_peak[k], user_bytes);
+            worst_peak[method] = max_peak[k] > worst_peak[method] ? max_peak[k]
+                                                                  : worst_peak[method];
+            bw_at_max[method] = bw;
+        }
+    }
+
+    if (rank == 0)
+    {
+        int largest = MIN_MSG_SIZE;
+        while (largest * 2 <= max_size)
+        {
+            largest *= 2;
+        }
+        printf("\n--- Results ---\n");
+        for (int method = 0; method < NUM_EXCHANGES; method++)
+        {
+            long user_bytes = (method == EXCHANGE_REPLACE ? 1L : 2L) * largest;
+            printf("%-9s %10.2f MB/s at %d bytes, user buffers %ld B, peak extra %.0f B\n",
+                   exchange_names[method], bw_at_max[method], largest, user_bytes,
+                   worst_peak[method]);
+            fprintf(outfile, "# %s: %.2f MB/s at %d bytes, user buffers %ld, peak extra %.0f\n",
+                    exchange_names[method], bw_at_max[method], largest, user_bytes,
+                    worst_peak[method]);
+        }
+        if (bw_at_max[EXCHANGE_SENDRECV] > 0)
+        {
+            printf("Sendrecv_replace: %.2fx Sendrecv bandwidth for half the user memory\n",
+                   bw_at_max[EXCHANGE_REPLACE] / bw_at_max[EXCHANGE_SENDRECV]);
+        }
+        printf("\n");
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(samples);
+    free(send_buffer);
+    free(recv_buffer);
+    return 0;
+}
+
+// Halo exchange variants timed by neighbor mode
+enum
+{
+    HALO_ALLTOALL,  // MPI_Neighbor_alltoall
+    HALO_ALLTOALLV, // MPI_Neighbor_alltoallv with equal counts
+    HALO_MANUAL,    // MPI_Irecv/MPI_Isend per neighbor + MPI_Waitall
+    NUM_HALOS
+};
+
+static const char *halo_names[NUM_HALOS] = {"alltoall", "alltoallv", "manual"};
+
+// Neighbors of a periodic Cartesian communicator in neighbor-collective order
+// (per dimension: the -1 then the +1 neighbor). Block i sent to neighbor i
+// arrives in the neighbor's block i^1, which tags the manual exchange so
+// repeated neighbors on small dimensions still match the right blocks.
+static int cart_neighbors(MPI_Comm cart, int ndims, int *neighbors)
+{
+    for (int d = 0; d < ndims; d++)
+    {
+        MPI_Cart_shift(cart, d, 1, &neighbors[2 * d], &neighbors[2 * d + 1]);
+    }
+    return 2 * ndims;
+}
+
+static void halo_exchange(int method, MPI_Comm comm, const int *neighbors, int n,
+                          char *send_buffer, char *recv_buffer, int msg_size, int *counts,
+                          int *displs, MPI_Request *requests)
+{
+    if (method == HALO_ALLTOALL)
+    {
+        MPI_Neighbor_alltoall(send_buffer, msg_size, MPI_BYTE, recv_buffer, msg_size, MPI_BYTE,
+                              comm);
+    }
+    else if (method == HALO_ALLTOALLV)
+    {
+        MPI_Neighbor_alltoallv(send_buffer, counts, displs, MPI_BYTE, recv_buffer, counts,
+                               displs, MPI_BYTE, comm);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            MPI_Irecv(recv_buffer + (size_t)i * msg_size, msg_size, MPI_BYTE, neighbors[i], i,
+                      comm, &requests[i]);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            MPI_Isend(send_buffer + (size_t)i * msg_size, msg_size, MPI_BYTE, neighbors[i],
+                      i ^ 1, comm, &requests[n + i]);
+        }
+        MPI_Waitall(2 * n, requests, MPI_STATUSES_IGNORE);
+    }
+}
+
+// Neighbor collectives versus a hand-written halo exchange over all ranks:
+// periodic 2D and 3D Cartesian grids from MPI_Dims_create, and a distributed
+// graph with the 2D grid's adjacency. Ranks are not reordered, so the manual
+// exchange runs on the same communicator and neighbor list. Time per exchange
+// is the slowest rank's loop average.
+static int run_neighbor(int argc, char *argv[], int rank, int num_procs)
+{
+    const char *out_path = opt_str(argc, argv, "out", "results_neighbor.csv");
+    int iterations = (int)opt_long(argc, argv, "iterations", NEIGHBOR_ITERATIONS);
+    int sizes[MAX_LIST];
+    int num_sizes = parse_int_list(opt_str(argc, argv, "sizes", NEIGHBOR_SIZES), sizes,
+                                   MAX_LIST);
+
+    iterations = iterations < 1 ? 1 : iterations;
+    int max_size = 1;
+    for (int i = 0; i < num_sizes; i++)
+    {
+        max_size = sizes[i] > max_size ? sizes[i] : max_size;
+    }
+
+    // Room for the 6 blocks of a 3D stencil
+    char *send_buffer, *recv_buffer;
+    if (!alloc_buffers(rank, 6 * (size_t)max_size, &send_buffer, &recv_buffer))
+    {
+        return 1;
+    }
+    MPI_Request requests[12];
+    int counts[6], displs[6];
+
+    enum
+    {
+        TOPO_CART2D,
+        TOPO_CART3D,
+        TOPO_GRAPH2D,
+        NUM_TOPOS
+    };
+    static const char *topo_names[NUM_TOPOS] = {"cart2d", "cart3d", "graph2d"};
+
+    FILE *outfile = NULL;
+    if (rank == 0)
+    {
+        outfile = open_output(out_path);
+        if (!outfile)
+        {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fprintf(outfile, "topology,dims,method,bytes_per_neighbor,time_us,aggregate_mbps,"
+                         "vs_manual\n");
+        printf("Neighbor Collectives vs Manual Halo (%d ranks, %d iterations)\n\n", num_procs,
+               iterations);
+        printf("%-8s %-10s %-10s %10s %12s %12s %10s\n", "Topology", "Dims", "Method",
+               "Size (B)", "Time (us)", "Agg (MB/s)", "vs manual");
+        printf("-------- ---------- ---------- ---------- ------------ ------------ ----------\n");
+    }
+
+    for (int topo = 0; topo < NUM_TOPOS; topo++)
+    {
+        int ndims = (topo == TOPO_CART3D) ? 3 : 2;
+        int dims[3] = {0, 0, 0}, periods[3] = {1, 1, 1};
+        MPI_Dims_create(num_procs, ndims, dims);
+
+        MPI_Comm cart, comm;
+        MPI_Cart_create(MPI_COMM_WORLD, ndims, dims, periods, 0, &cart);
+        int neighbors[6];
+        int n = cart_neighbors(cart, ndims, neighbors);
+        if (topo == TOPO_GRAPH2D)
+        {
+            // Unit weights rather than MPI_UNWEIGHTED, which some compilers
+            // flag as an out-of-bounds read of the library's sentinel
+            int weights[6] = {1, 1, 1, 1, 1, 1};
+            MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, n, neighbors, weights, n, neighbors,
+                                           weights, MPI_INFO_NULL, 0, &comm);
+        }
+        else
+        {
+            comm = cart;
+        }
+
+        char dims_text[32];
+        if (ndims == 3)
+        {
+            snprintf(dims_text, sizeof(dims_text), "%dx%dx%d", dims[0], dims[1], dims[2]);
+        }
+        else
+        {
+            snprintf(dims_text, sizeof(dims_text), "%dx%d", dims[0], dims[1]);
+        }
+
+        for (int s = 0; s < num_sizes; s++)
+        {
+            int msg_size = sizes[s];
+            for (int i = 0; i < n; i++)
+            {
+                counts[i] = msg_size;
+                displs[i] = i * msg_size;
+            }
+
+            double time_us[NUM_HALOS];
+            for (int method = 0; method < NUM_HALOS; method++)
+            {
+                for (int i = 0; i < WARMUP_ITERATIONS; i++)
+                {
+                    halo_exchange(method, comm, neighbors, n, send_buffer, recv_buffer, msg_size,
+                                  counts, displs, requests);
+                }
+                MPI_Barrier(comm);
+                double t_start = get_time_us();
+                for (int i = 0; i < iterations; i++)
+                {
+                    halo_exchange(method, comm, neighbors, n, send_buffer, recv_buffer, msg_size,
+                                  counts, displs, requests);
+                }
+                double elapsed = (get_time_us() - t_start) / iterations;
+                MPI_Reduce(&elapsed, &time_us[method], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+            }
+
+            if (rank == 0)
+            {
+                for (int method = 0; method < NUM_HALOS; method++)
+                {
+                    double total_bytes = (double)num_procs * n * msg_size;
+                    double bw = time_us[method] > 0 ? total_bytes / time_us[method] : 0.0;
+                    double ratio = time_us[method] > 0 ? time_us[HALO_MANUAL] / time_us[method]
+                                                       : 0.0;
+                    printf("%-8s %-10s %-10s %10d %12.2f %12.2f %9.2fx\n", topo_names[topo],
+                           dims_text, halo_names[method], msg_size, time_us[method], bw, ratio);
+                    fprintf(outfile, "%s,%s,%s,%d,%.3f,%.2f,%.3f\n", topo_names[topo],
+                            dims_text, halo_names[method], msg_size, time_us[method], bw, ratio);
+                }
+            }
+        }
+
+        if (comm != cart)
+        {
+            MPI_Comm_free(&comm);
+        }
+        MPI_Comm_free(&cart);
+    }
+
+    if (rank == 0)
+    {
+        printf("\nvs manual > 1 means the neighbor collective is faster than Isend/Irecv\n\n");
+        fprintf(outfile, "\n# vs_manual = manual time / method time\n");
+        fclose(outfile);
+        printf("Saved to %s\n", out_path);
+    }
+
+    // Cleanup
+    free(send_buffer);
+    free(recv_buffer);
     return 0;
 }
+
+static const Mode modes[] = {
+    {"sweep", run_sweep, 1, "Power-of-two size sweep (default)"},
+    {"refine", run_refine, 1, "Log sweep refined with linear steps at discontinuities"},
+    {"mtu", run_mtu, 1, "Byte-step probe around packet boundaries, infers payload"},
+    {"barrier", run_barrier, 0, "MPI_Barrier latency and exit skew across process counts"},
+    {"startup", run_startup, 0, "MPI_Init, communicator creation and first-message costs"},
+    {"mesh", run_mesh, 0, "First-contact vs steady-state latency to every peer"},
+    {"cpucost", run_cpucost, 1, "Latency vs CPU time for blocking, spin, yield, wait"},
+    {"match", run_match, 1, "Latency vs posted/unexpected queue depth and position"},
+    {"unexpected", run_unexpected, 1, "Expected vs unexpected receive path per size"},
+    {"multicomm", run_multicomm, 1, "Concurrent streams on 1..C duplicated communicators"},
+    {"overhead", run_overhead, 0, "Per-iteration cost of the timed kernels per timer"},
+    {"batch", run_batch, 1, "Blocks of B round trips per sample to beat timer granularity"},
+    {"load", run_load, 1, "Small-message latency percentiles under background bulk load"},
+    {"openloop", run_openloop, 1, "Open-loop offered-rate sweep, coordinated-omission safe"},
+    {"rpc", run_rpc, 1, "Request/response grid with think time and pipelining depth"},
+    {"rails", run_rails, 0, "Aggregate bandwidth of 1..K concurrent pairs (one per NIC)"},
+    {"chunked", run_chunked, 1, "Large messages split into windowed chunks vs monolithic"},
+    {"regcache", run_regcache, 1, "Registration cost: reused vs fresh buffers vs buffer pools"},
+    {"footprint", run_footprint, 0, "RSS growth per connected peer, request and large transfer"},
+    {"iostall", run_iostall, 1, "Next-size warmup with and without a flushed stdio row before it"},
+    {"cvars", run_cvars, 1, "Sweep writable MPI_T eager/chunk cvars; best setting per size band"},
+    {"exchange", run_exchange, 1, "Sendrecv vs Sendrecv_replace vs Isend/Irecv: bandwidth, memory"},
+    {"neighbor", run_neighbor, 0, "Neighbor alltoall(v) on Cartesian/graph grids vs manual halo"},
+};
+
+#define NUM_MODES ((int)(sizeof(modes) / sizeof(modes[0])))
+
+static void print_usage(void)
+{
+    fprintf(stderr, "Usage: mpirun -np 2 ./pingpong [mode] [--option=value ...]\n");
+    fprintf(stderr, "Modes:\n");
+    for (int i = 0; i < NUM_MODES; i++)
+    {
+        fprintf(stderr, "  %-10s %s\n", modes[i].name, modes[i].description);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, num_procs;
+
+    startup_exec_us = exec_elapsed_us();
+
+    // --thread-level selects MPI_Init_thread instead of MPI_Init
+    const char *level = opt_str(argc, argv, "thread-level", NULL);
+    double t_init = get_time_us();
+    if (level)
+    {
+        int required = MPI_THREAD_SINGLE;
+        if (strcmp(level, "funneled") == 0)
+        {
+            required = MPI_THREAD_FUNNELED;
+        }
+        else if (strcmp(level, "serialized") == 0)
+        {
+            required = MPI_THREAD_SERIALIZED;
+        }
+        else if (strcmp(level, "multiple") == 0)
+        {
+            required = MPI_THREAD_MULTIPLE;
+        }
+        MPI_Init_thread(&argc, &argv, required, &thread_provided);
+    }
+    else
+    {
+        MPI_Init(&argc, &argv);
+    }
+    startup_init_us = get_time_us() - t_init;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // Must precede any output on stdout
+    output_live = strcmp(opt_str(argc, argv, "output", "buffered"), "live") == 0;
+    if (!output_live)
+    {
+        setvbuf(stdout, stdout_buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+    }
+
+    // First non-option argument selects the mode
+    const Mode *mode = &modes[0];
+    if (argc > 1 && strncmp(argv[1], "--", 2) != 0)
+    {
+        mode = NULL;
+        for (int i = 0; i < NUM_MODES; i++)
+        {
+            if (strcmp(argv[1], modes[i].name) == 0)
+            {
+                mode = &modes[i];
+            }
+        }
+        if (!mode)
+        {
+            if (rank == 0)
+            {
+                fprintf(stderr, "Error: Unknown mode '%s'\n", argv[1]);
+                print_usage();
+            }
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
+    // Ensure exactly 2 processes
+    if (mode->needs_pair && num_procs != 2)
+    {
+        if (rank == 0)
+        {
+            fprintf(stderr, "Error: This program requires exactly 2 processes.\n");
+            fprintf(stderr, "Usage: mpirun -np 2 -N 2 ./pingpong\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Start-of-loop synchronization used by the ping-pong modes
+    const char *sync = opt_str(argc, argv, "sync", "barrier");
+    if (strcmp(sync, "double") == 0)
+    {
+        sync_mode = SYNC_DOUBLE;
+    }
+    else if (strcmp(sync, "ping") == 0)
+    {
+        sync_mode = SYNC_PING;
+    }
+
+    // Clock used by the timed kernels
+    const char *timer = opt_str(argc, argv, "timer", "gtod");
+    for (int i = 0; i < NUM_TIMERS; i++)
+    {
+        if (strcmp(timer, timer_names[i]) == 0)
+        {
+            timer_backend = i;
+        }
+    }
+    calibrate_tsc();
+    pvar_setup(rank, opt_str(argc, argv, "pvars", NULL));
+
+    int status = mode->run(argc, argv, rank, num_procs);
+
+    pvar_finalize();
+    MPI_Finalize();
+    return status;
+}
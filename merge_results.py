@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Merge env_sweep.py runs into one tagged dataset and rank them per size band."""
+
+import argparse
+import csv
+import os
+
+INDEX_FILE = "index.csv"
+MERGED_FILE = "merged.csv"
+RANKING_FILE = "ranking.csv"
+DEFAULT_BANDS = [1024, 65536]  # Upper bounds: small <= 1 KB, medium <= 64 KB, large above
+
+
+def read_rows(path):
+    """Return (header, rows) of a pingpong CSV, skipping '#' metadata lines."""
+    with open(path, "r") as f:
+        reader = csv.reader(f)
+        header = next(reader)
+        rows = [row for row in reader if row and row[0].strip() and not row[0].startswith("#")]
+    return header, rows
+
+
+def band_name(lo, hi):
+    """Label for sizes in (lo, hi]; hi None means unbounded."""
+
+    def fmt(n):
+        return f"{n // 1024}K" if n >= 1024 and n % 1024 == 0 else str(n)
+
+    if hi is None:
+        return f">{fmt(lo)}"
+    return f"<={fmt(hi)}" if lo == 0 else f"{fmt(lo)}-{fmt(hi)}"
+
+
+def merge(outdir, bands):
+    with open(os.path.join(outdir, INDEX_FILE), "r") as f:
+        runs = [r for r in csv.DictReader(f) if r["exit_status"] == "0"]
+    if not runs:
+        print("No successful runs to merge")
+        return
+
+    # One dataset: run id and tag prepended to every result row
+    merged_header = None
+    per_run = {}
+    with open(os.path.join(outdir, MERGED_FILE), "w", newline="") as f:
+        writer = csv.writer(f)
+        for run in runs:
+            header, rows = read_rows(run["output"])
+            if merged_header is None:
+                merged_header = header
+                writer.writerow(["run_id", "tag"] + header)
+            elif header != merged_header:
+                print(f"Skipping run {run['run_id']}: columns differ from the first run")
+                continue
+            for row in rows:
+                writer.writerow([run["run_id"], run["tag"]] + row)
+            per_run[run["run_id"]] = [
+                (
+                    int(row[header.index("msg_size_bytes")]),
+                    float(row[header.index("rtt_us")]),
+                    float(row[header.index("bandwidth_mbps")]),
+                )
+                for row in rows
+            ]
+
+    # Mean RTT and bandwidth of each run within each band, ranked
+    edges = [0] + sorted(bands) + [None]
+    tags = {run["run_id"]: run["tag"] for run in runs}
+    with open(os.path.join(outdir, RANKING_FILE), "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["band", "rank_latency", "rank_bandwidth", "run_id", "tag",
+                         "mean_rtt_us", "mean_bandwidth_mbps"])
+        for lo, hi in zip(edges[:-1], edges[1:]):
+            name = band_name(lo, hi)
+            scores = []
+            for run_id, points in per_run.items():
+                inside = [p for p in points if p[0] > lo and (hi is None or p[0] <= hi)]
+                if inside:
+                    rtt = sum(p[1] for p in inside) / len(inside)
+                    bw = sum(p[2] for p in inside) / len(inside)
+                    scores.append((run_id, rtt, bw))
+            if not scores:
+                continue
+
+            by_latency = sorted(scores, key=lambda s: s[1])
+            by_bandwidth = sorted(scores, key=lambda s: -s[2])
+            print(f"\nBand {name} bytes")
+            print(f"{'Lat':>4} {'BW':>4} {'RTT (us)':>12} {'BW (MB/s)':>12}  Configuration")
+            for run_id, rtt, bw in by_latency:
+                lat_rank = by_latency.index((run_id, rtt, bw)) + 1
+                bw_rank = by_bandwidth.index((run_id, rtt, bw)) + 1
+                print(f"{lat_rank:>4} {bw_rank:>4} {rtt:>12.2f} {bw:>12.2f}  {tags[run_id]}")
+                writer.writerow([name, lat_rank, bw_rank, run_id, tags[run_id],
+                                 f"{rtt:.3f}", f"{bw:.2f}"])
+
+    print(f"\nMerged data: {os.path.join(outdir, MERGED_FILE)}")
+    print(f"Ranking: {os.path.join(outdir, RANKING_FILE)}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument(
+        "outdir", nargs="?", default="env_sweep", help="env_sweep.py output directory"
+    )
+    parser.add_argument(
+        "--bands",
+        default=",".join(str(b) for b in DEFAULT_BANDS),
+        help="upper size bounds of the bands used for ranking",
+    )
+    args = parser.parse_args()
+    merge(args.outdir, [int(b) for b in args.bands.split(",") if b])
+
+
+if __name__ == "__main__":
+    main()